@@ -0,0 +1,336 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cassert>
+
+#include "batch.h"
+#include "evaluate.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "tt.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+  // A batch search walks its tree with an explicit stack of frames instead
+  // of recursion, so that it can be suspended at any node and resumed later.
+  enum Phase { PHASE_PROBE, PHASE_MOVES, PHASE_CHILD };
+
+  struct Frame {
+    MoveStack moves[MAX_MOVES];
+    MoveStack *cur, *last;
+    StateInfo st;
+    Key key;
+    Value alpha, beta, oldAlpha, bestValue;
+    Move ttMove, bestMove, currentMove;
+    Depth depth;
+    Phase phase;
+    bool hasLegalMove;
+  };
+
+  struct BatchTask {
+    Position* pos;
+    Frame stack[PLY_MAX];
+    int ply, index;
+    Depth depth, iterationDepth;
+    Value childValue;
+  };
+
+  // Mate scores are stored in the TT relative to the node, as the main search does
+  Value value_to_tt(Value v, int ply) {
+
+    return v >= VALUE_MATE_IN_PLY_MAX  ? v + ply
+         : v <= VALUE_MATED_IN_PLY_MAX ? v - ply : v;
+  }
+
+  Value value_from_tt(Value v, int ply) {
+
+    return v >= VALUE_MATE_IN_PLY_MAX  ? v - ply
+         : v <= VALUE_MATED_IN_PLY_MAX ? v + ply : v;
+  }
+
+  // enter_node() sets up the frame for the current position of the task.
+  // The TT cluster has already been prefetched by do_move() (we do it here
+  // for the root) and the probe is deferred until the task is resumed.
+  void enter_node(BatchTask& t, Value alpha, Value beta, Depth depth) {
+
+    Frame& f = t.stack[t.ply];
+
+    f.key = t.pos->get_key();
+    f.alpha = f.oldAlpha = alpha;
+    f.beta = beta;
+    f.depth = depth;
+    f.phase = PHASE_PROBE;
+
+    if (t.ply == 0)
+        prefetch((char*)TT.first_entry(f.key));
+  }
+
+  // leave_node() returns the value of the current node to its parent
+  void leave_node(BatchTask& t, Value v) {
+
+    t.childValue = v;
+    t.ply--;
+  }
+
+  // probe_node() looks up the TT, then either returns a value right away or
+  // generates and orders the moves of the node.
+  void probe_node(BatchTask& t, Frame& f) {
+
+    Position& pos = *t.pos;
+    Value margin;
+
+    if (t.ply > 0 && pos.is_draw())
+    {
+        leave_node(t, VALUE_DRAW);
+        return;
+    }
+
+    if (t.ply >= PLY_MAX - 1)
+    {
+        leave_node(t, pos.in_check() ? VALUE_DRAW : evaluate(pos, margin));
+        return;
+    }
+
+    const TTEntry* tte = TT.probe(f.key);
+    f.ttMove = tte ? tte->move() : MOVE_NONE;
+
+    if (t.ply > 0 && tte && tte->depth() >= f.depth)
+    {
+        Value v = value_from_tt(tte->value(), t.ply);
+
+        if (   tte->type() == VALUE_TYPE_EXACT
+            || ((tte->type() & VALUE_TYPE_LOWER) && v >= f.beta)
+            || ((tte->type() & VALUE_TYPE_UPPER) && v <= f.alpha))
+        {
+            leave_node(t, v);
+            return;
+        }
+    }
+
+    f.bestValue = -VALUE_INFINITE;
+    f.bestMove = MOVE_NONE;
+    f.hasLegalMove = false;
+
+    if (pos.in_check())
+        f.last = generate<MV_EVASION>(pos, f.moves);
+
+    else if (f.depth > DEPTH_ZERO)
+        f.last = generate<MV_NON_EVASION>(pos, f.moves);
+
+    else
+    {
+        // Quiescence, stand pat on the static evaluation and try captures only
+        f.bestValue = evaluate(pos, margin);
+
+        if (f.bestValue >= f.beta)
+        {
+            leave_node(t, f.bestValue);
+            return;
+        }
+        f.alpha = Max(f.alpha, f.bestValue);
+        f.hasLegalMove = true;
+        f.last = generate<MV_CAPTURE>(pos, f.moves);
+    }
+
+    // TT move first, then captures in MVV/LVA order
+    for (MoveStack* cur = f.moves; cur != f.last; cur++)
+    {
+        Move m = cur->move;
+
+        if (m == f.ttMove)
+            cur->score = 2 * QueenValueMidgame;
+        else if (pos.move_is_capture(m))
+            cur->score =  PieceValueMidgame[pos.type_of_piece_on(move_to(m))]
+                        - int(pos.type_of_piece_on(move_from(m)));
+        else
+            cur->score = move_is_promotion(m) ? PieceValueMidgame[move_promotion_piece(m)] : 0;
+    }
+
+    f.cur = f.moves;
+    f.phase = PHASE_MOVES;
+  }
+
+  // next_move() makes the next legal move of the node and enters the child
+  // node, or stores the result in TT and leaves when all moves are done.
+  // Returns true when a new node has been entered.
+  bool next_move(BatchTask& t, Frame& f) {
+
+    Position& pos = *t.pos;
+
+    while (f.cur != f.last)
+    {
+        std::swap(*f.cur, *std::max_element(f.cur, f.last));
+        Move m = (f.cur++)->move;
+
+        if (!pos.pl_move_is_legal(m))
+            continue;
+
+        f.hasLegalMove = true;
+        f.currentMove = m;
+        f.phase = PHASE_CHILD;
+
+        Depth newDepth = f.depth - ONE_PLY;
+
+        pos.do_move(m, f.st);
+        t.ply++;
+        enter_node(t, -f.beta, -f.alpha, newDepth < DEPTH_ZERO ? DEPTH_QS_NO_CHECKS : newDepth);
+        return true;
+    }
+
+    if (!f.hasLegalMove)
+        f.bestValue = pos.in_check() ? value_mated_in(t.ply) : VALUE_DRAW;
+
+    ValueType vt =  f.bestValue >= f.beta    ? VALUE_TYPE_LOWER
+                  : f.bestValue > f.oldAlpha ? VALUE_TYPE_EXACT : VALUE_TYPE_UPPER;
+
+    TT.store(f.key, value_to_tt(f.bestValue, t.ply), vt, f.depth, f.bestMove, VALUE_NONE, VALUE_NONE);
+    leave_node(t, f.bestValue);
+    return false;
+  }
+
+  // child_done() takes back the move once its subtree has been searched
+  void child_done(BatchTask& t, Frame& f) {
+
+    Value v = -t.childValue;
+
+    t.pos->undo_move(f.currentMove);
+
+    if (v > f.bestValue)
+    {
+        f.bestValue = v;
+        f.bestMove = f.currentMove;
+
+        if (v > f.alpha)
+            f.alpha = v;
+    }
+
+    // On a cutoff skip the remaining moves, next_move() stores and leaves
+    if (v >= f.beta)
+        f.cur = f.last;
+
+    f.phase = PHASE_MOVES;
+  }
+
+  // step() runs the task until it enters a new node, at which point the
+  // thread should switch to another task. Returns false when the root
+  // node has been left and the search is finished.
+  bool step(BatchTask& t) {
+
+    while (t.ply >= 0)
+    {
+        Frame& f = t.stack[t.ply];
+
+        switch (f.phase) {
+        case PHASE_PROBE:
+            probe_node(t, f);
+            break;
+        case PHASE_MOVES:
+            if (next_move(t, f))
+                return true;
+            break;
+        case PHASE_CHILD:
+            child_done(t, f);
+            break;
+        }
+    }
+    return false;
+  }
+
+  // start_task() sets up a task to search the given position from the root.
+  // The search is iteratively deepened, so that the TT provides the moves to
+  // try first at the next iteration.
+  void start_task(BatchTask& t, const string& fen, int index, Depth depth) {
+
+    t.pos = new Position(fen, false, 0);
+    t.index = index;
+    t.depth = depth;
+    t.iterationDepth = ONE_PLY;
+    t.ply = 0;
+    enter_node(t, -VALUE_INFINITE, VALUE_INFINITE, t.iterationDepth);
+  }
+
+  // next_iteration() restarts the search from the root one ply deeper.
+  // Returns false when the last iteration has been searched.
+  bool next_iteration(BatchTask& t) {
+
+    if (t.iterationDepth >= t.depth)
+        return false;
+
+    t.iterationDepth += ONE_PLY;
+    t.ply = 0;
+    enter_node(t, -VALUE_INFINITE, VALUE_INFINITE, t.iterationDepth);
+    return true;
+  }
+
+} // namespace
+
+
+/// batch_search() searches all the positions in fenList to the given depth,
+/// keeping up to 'width' searches in flight, and fills 'results' in the same
+/// order as fenList. With width 1 the searches run one after the other.
+
+void batch_search(const vector<string>& fenList, Depth depth, int width, vector<BatchResult>& results) {
+
+  assert(width > 0);
+
+  vector<BatchTask*> tasks;
+  size_t next = 0;
+
+  results.resize(fenList.size());
+
+  for (int i = 0; i < width && next < fenList.size(); i++)
+  {
+      tasks.push_back(new BatchTask);
+      start_task(*tasks.back(), fenList[next], int(next), depth);
+      next++;
+  }
+
+  // Round robin among the tasks in flight, each finished one is replaced by
+  // the next position until the list is exhausted.
+  while (!tasks.empty())
+      for (size_t i = 0; i < tasks.size(); i++)
+      {
+          BatchTask& t = *tasks[i];
+
+          if (step(t) || next_iteration(t))
+              continue;
+
+          BatchResult& r = results[t.index];
+          r.move = t.stack[0].bestMove;
+          r.value = t.childValue;
+          r.nodes = t.pos->nodes_searched();
+          delete t.pos;
+
+          if (next < fenList.size())
+          {
+              start_task(t, fenList[next], int(next), depth);
+              next++;
+          }
+          else
+          {
+              delete tasks[i];
+              tasks.erase(tasks.begin() + i--);
+          }
+      }
+}
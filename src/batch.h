@@ -0,0 +1,46 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(BATCH_H_INCLUDED)
+#define BATCH_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "move.h"
+#include "types.h"
+
+/// A batch search analyses many independent positions to a fixed depth from
+/// a single OS thread. Several searches are kept in flight at once and the
+/// thread switches to the next one each time a search reaches a new node, so
+/// the transposition table, pawn and material hash lines prefetched by
+/// do_move() arrive while the other searches are running instead of stalling
+/// the probe. The searches are a plain alpha-beta with quiescence and share
+/// the global transposition table.
+
+struct BatchResult {
+  Move move;
+  Value value;
+  uint64_t nodes;
+};
+
+extern void batch_search(const std::vector<std::string>& fenList, Depth depth,
+                         int width, std::vector<BatchResult>& results);
+
+#endif // !defined(BATCH_H_INCLUDED)
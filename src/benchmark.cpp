@@ -17,12 +17,22 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <vector>
 
+#include "batch.h"
+#include "cluster.h"
+#include "evaluate.h"
+#include "mate.h"
+#include "movegen.h"
+#include "nnue.h"
 #include "position.h"
 #include "search.h"
+#include "thread.h"
+#include "tt.h"
 #include "ucioption.h"
 
 using namespace std;
@@ -48,35 +58,518 @@ static const string Defaults[] = {
 };
 
 
+// Positions of the categorized suites, selected by their name in place of
+// the FEN file name, "all" runs the four of them.
+
+static const string OpeningPositions[] = {
+  "r1bqk2r/1pppbppp/p1n2n2/4p3/B3P3/5N2/PPPP1PPP/RNBQ1RK1 w kq -",
+  "r1bqk2r/ppp2ppp/2np1n2/2b1p3/2B1P3/2PP1N2/PP3PPP/RNBQK2R w KQkq -",
+  "rnbqkb1r/1p2pppp/p2p1n2/8/3NP3/2N5/PPP2PPP/R1BQKB1R w KQkq -",
+  "r1bqk1nr/pp1pppbp/2n3p1/8/2PNP3/8/PP3PPP/RNBQKB1R w KQkq -",
+  "rnbqk2r/pppnbppp/4p3/3pP1B1/3P4/2N5/PPP2PPP/R2QKBNR w KQkq -",
+  "rn1qkbnr/pp3ppp/4p3/2ppPb2/3P4/5N2/PPP1BPPP/RNBQK2R w KQkq -",
+  "rnbq1rk1/ppp1bppp/4pn2/3p2B1/2PP4/2N1P3/PP3PPP/R2QKBNR w KQ -",
+  "rn1qkb1r/pp2pppp/2p2n2/5b2/P1pP4/2N2N2/1P2PPPP/R1BQKB1R w KQkq -",
+  "rnbq1rk1/ppp1ppbp/3p1np1/8/2PPP3/2N2N2/PP3PPP/R1BQKB1R w KQ -",
+  "rnbq1rk1/ppp2ppp/4pn2/3p4/1bPP4/2NBP3/PP3PPP/R1BQK1NR w KQ -",
+  "rn1qk2r/pbppbppp/1p2pn2/8/2PP4/5NP1/PP2PPBP/RNBQK2R w KQkq -",
+  "r1bqkb1r/ppp2ppp/2n5/3np3/8/2N2NP1/PP1PPP1P/R1BQKB1R w KQkq -",
+  "r2qkb1r/pp1npppp/2p2n2/3p4/6b1/3P1NP1/PPP1PPBP/RNBQ1RK1 w kq -",
+  "rnbqk2r/pp2ppbp/3p1np1/2p5/3PPP2/2N2N2/PPP3PP/R1BQKB1R w KQkq -",
+  "rn1qkb1r/ppp2ppp/3pp3/3nP3/3P2b1/5N2/PPP1BPPP/RNBQK2R w KQkq -",
+  "rn2kb1r/ppp1pppp/5n2/q4b2/3P4/2N2N2/PPP2PPP/R1BQKB1R w KQkq -",
+  "rnbq1rk1/ppppp1bp/5np1/5p2/3P4/5NP1/PPP1PPBP/RNBQ1RK1 w - -",
+  "rn1qkb1r/3ppppp/b4n2/2pP4/8/8/PP2PPPP/RNBQKBNR w KQkq -",
+  "rnbqkb1r/ppp2ppp/8/3p4/3Pn3/5N2/PPP2PPP/RNBQKB1R w KQkq -",
+  "rnbqkb1r/pppp1p1p/5n2/4N3/4PppP/8/PPPP2P1/RNBQKB1R w KQkq -",
+  "rnbqkb1r/pp3ppp/4pn2/2p5/2BP4/4PN2/PP3PPP/RNBQK2R w KQkq -",
+  "r1bqk1nr/pp2ppbp/2np2p1/2p5/4P3/2NP2P1/PPP2PBP/R1BQK1NR w KQkq -",
+  "rn1qkb1r/pb1p1ppp/1p2pn2/2p3B1/3P4/4PN2/PPPN1PPP/R2QKB1R w KQkq -",
+  "r1bqkb1r/p1pp1ppp/2p2n2/8/4P3/8/PPP2PPP/RNBQKB1R w KQkq -",
+  "r1bqk2r/pp1pppbp/2n2np1/2p5/2P5/2N2NP1/PP1PPPBP/R1BQK2R w KQkq -",
+  "r1bqkb1r/pp1ppppp/2n5/3nP3/3p4/2P2N2/PP3PPP/RNBQKB1R w KQkq -",
+  ""
+};
+
+static const string MiddlegamePositions[] = {
+  "r3r1k1/1pp2ppp/p2qbb2/2p1N3/2P5/2BP2Q1/PP3PPP/R3R1K1 w - -",
+  "r4rk1/1pp1nppp/p2pb1q1/P3p2n/BP2P3/2PPNN2/4QPPP/R4RK1 w - -",
+  "r2r2k1/1p3ppp/pq3b2/4pP2/3n4/3BB3/PPQ2PPP/2R2RK1 w - -",
+  "1rbr2k1/p2qppbp/2p3p1/2Pn4/Q7/3B1N2/PP1B1PPP/1R3RK1 w - -",
+  "5rk1/1ppb2pp/p1n1p3/3p4/3P1r2/P1N2N2/1PP2PPP/3RR1K1 w - -",
+  "2r2rk1/p3bppp/2p1p1b1/q1PpP3/N2N1Q2/4P3/PPP3PP/R4RK1 w - -",
+  "r4rk1/pp1bqp2/2n4p/3Q2p1/4B3/5N2/PP3PPP/R4RK1 w - -",
+  "r3kbr1/pp2p2p/2p1p3/4Pn2/P3NP2/6P1/1P2K2P/R1B4R w q -",
+  "r2q1k2/pp2pp1p/3p1np1/5b2/2P5/2Q2P2/PP2B1PP/R2R2K1 w - -",
+  "r2r2k1/p4ppp/qp1bpn2/4N3/1n1P4/2N5/PP1BQPPP/2R2RK1 w - -",
+  "r4rk1/pb3ppp/1pp1p3/4P3/8/3q2P1/PP2PPBP/2R2RK1 w - -",
+  "2kr3r/ppp2Npp/3b4/5p2/1nn1p3/2N1P1P1/PP1P1P1P/R1B2RK1 w - -",
+  "r3k2r/1p3ppp/5n2/q2p1B2/pb1Pp3/6P1/1P2PP1P/R1BQ1RK1 w kq -",
+  "rn2r1k1/pp4bp/1q2p1p1/1N1p2N1/4nP2/3Q3P/PPPB2P1/2KR3R w - -",
+  "3rkb1r/pp3qpp/1n2p3/2p5/4Q3/2N5/PP3PPP/R1BR2K1 w k -",
+  "1k1r4/pppr2pp/1q1b1n2/4p3/1P1n4/P1NB4/2PB1PPP/R2QR1K1 w - -",
+  "r4rk1/pp3qb1/n1ppbnpp/4p3/3P1pPN/PPN2P2/2PBPQBP/R4RK1 w - -",
+  "rr4k1/4qppp/n2p1n2/3Pp1B1/2p1P3/P4N2/1PQ1KPPP/R1R5 w - -",
+  "4r1k1/p1pq1ppp/2pb4/6B1/3P2bN/5p2/PPP3PP/R2Q2K1 w - -",
+  "r4rk1/pp3pbp/8/q2bP3/2P2BpP/1Q6/PP2K1P1/R6R w - -",
+  "r1b1r1k1/3n1ppp/1pN1pn2/pPb5/N1B5/4P3/PB3PPP/2RR2K1 w - -",
+  "r1r3k1/p1qb1pb1/P2p1npp/1pp1p3/3nP3/R1NP1NPP/1PPB1PB1/3QR1K1 w - -",
+  "r3kb2/p4p2/1pb1pp1p/3q4/2NP2r1/5N2/PP3PPP/2RQ1RK1 w q -",
+  "2rr2k1/p4ppp/1qp2n2/3p4/8/3B4/PPP2PPP/R1Q2RK1 w - -",
+  "r2r2k1/1p1bpp2/1pnp1bpp/2p1n3/2P5/PPNP1NPP/3BPPB1/RR4K1 w - -",
+  "r4rk1/pN3ppp/1n3bb1/8/3n1B2/1B3N2/PP3PPP/2R2RK1 w - -",
+  ""
+};
+
+static const string EndgamePositions[] = {
+  "8/8/8/4k3/8/8/4P3/4K3 w - -",
+  "8/8/4k3/8/4K3/4P3/8/8 w - -",
+  "8/8/8/8/8/2k5/2p5/2K5 b - -",
+  "1K1k4/1P6/8/8/8/8/r7/2R5 w - -",
+  "8/8/8/8/8/4k3/R7/4K3 w - -",
+  "8/8/8/4k3/8/8/8/3BNK2 w - -",
+  "8/8/8/3k4/8/8/8/2QK1r2 w - -",
+  "8/8/4k3/3r4/4K3/8/3Q4/8 w - -",
+  "8/5pk1/6p1/7p/7P/5KP1/5P2/8 w - -",
+  "8/p4pk1/1p4p1/8/8/1P4P1/P4PK1/8 w - -",
+  "8/6k1/5p2/3Bp1p1/1b2P1P1/5P2/6K1/8 w - -",
+  "8/8/3kp3/1p1p4/1P1P1P2/4K3/8/8 w - -",
+  "6k1/5ppp/8/8/8/8/r4PPP/2R3K1 b - -",
+  "2r3k1/5pp1/7p/8/8/7P/5PP1/3R2K1 w - -",
+  "8/1p3k2/p1p1rpp1/P1P5/1P1R1PP1/4K3/8/8 w - -",
+  "8/5k2/8/3R4/5K2/4P3/r7/8 w - -",
+  "2k5/8/8/2PK4/8/8/r7/1R6 b - -",
+  "8/8/1p6/1P3k2/8/5K2/2n5/4B3 w - -",
+  "8/3k4/3p4/3P1p2/2K2P2/8/3N4/3b4 w - -",
+  "8/8/pp6/2p1k3/P1P5/1P2K3/8/8 w - -",
+  "8/8/1k6/8/2P5/7p/5K2/8 w - -",
+  "8/6pk/7p/8/P7/8/6PP/6K1 w - -",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - -",
+  "6k1/6p1/8/6KQ/1r6/q2b4/8/8 w - -",
+  "8/8/8/3k4/8/8/8/2Q1K3 w - -",
+  "8/8/8/8/8/5K2/7Q/5k2 w - -",
+  "7k/5K2/8/6P1/8/8/8/8 w - -",
+  "8/8/2k5/8/2K5/8/1P6/8 w - -",
+  ""
+};
+
+static const string TacticalPositions[] = {
+  "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - -",
+  "8/7p/5k2/5p2/p1p2P2/Pr1pPK2/1P1R3P/8 b - -",
+  "5rk1/1ppb3p/p1pb4/6q1/3P1p1r/2P1R2P/PP1BQ1P1/5RKN w - -",
+  "r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - -",
+  "5k2/6pp/p1qN4/1p1p4/3P4/2PKP2Q/PP3r2/3R4 b - -",
+  "7k/p7/1R5K/6r1/6p1/6P1/8/8 w - -",
+  "rnbqkb1r/pppp1ppp/8/4P3/6n1/7P/PPPNPPP1/R1BQKBNR b KQkq -",
+  "r4q1k/p2bR1rp/2p2Q1N/5p2/5p2/2P5/PP3PPP/R5K1 w - -",
+  "3q1rk1/p4pp1/2pb3p/3p4/6Pr/1PNQ4/P1PB1PP1/4RRK1 b - -",
+  "2br2k1/2q3rn/p2NppQ1/2p1P3/Pp5R/4P3/1P3PPP/3R2K1 w - -",
+  "r1b1kb1r/3q1ppp/pBp1pn2/8/Np3P2/5B2/PPP3PP/R2Q1RK1 w kq -",
+  "4k1r1/2p3r1/1pR1p3/3pP2p/3P2qP/P4N2/1PQ4P/5R1K b - -",
+  "5rk1/pp4p1/2n1p2p/2Npq3/2p5/6P1/P3P1BP/R4Q1K w - -",
+  "r2qkb1r/1ppb1ppp/p7/4p3/P1Q1P3/2P5/5PPP/R1B2KNR b kq -",
+  "r1b3kr/ppp1Bp1p/1b6/n2P4/2p3q1/2Q2N2/P4PPP/RN2R1K1 w - -",
+  "r2q1rk1/1b1nbppp/p2p1n2/1p1Pp3/4P3/1BN1BN1P/PP3PP1/R2QR1K1 w - -",
+  "6k1/5p2/3P2p1/7n/3QPP2/7q/r5P1/5RK1 b - -",
+  "r1bqk2r/ppp2ppp/2n5/3np3/1bB5/2NP1N2/PPP2PPP/R1BQK2R w KQkq -",
+  "r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - -",
+  "2r3k1/pp4rp/1q1p2pQ/1N2p1PR/2nNP3/5P2/PPP5/2K4R w - -",
+  "r4rk1/ppp2ppp/2n5/2bqp3/8/P2PB3/1PP1NPPP/R2Q1RK1 w - -",
+  "1r1r2k1/p1q2ppp/3bp3/8/3B4/P2Q1N2/1P3PPP/2R2RK1 w - -",
+  "r3kb1r/pp1n1ppp/1q2p3/n2p4/3P1Bb1/2PB1N2/PPQ2PPP/RN2K2R w KQkq -",
+  "6k1/p4pp1/Pp2r3/1QPq3p/8/6P1/5P1P/R5K1 w - -",
+  ""
+};
+
+struct BenchCategory {
+  const char* name;
+  const string* positions;
+};
+
+static const BenchCategory Categories[] = {
+  { "opening",    OpeningPositions    },
+  { "middlegame", MiddlegamePositions },
+  { "endgame",    EndgamePositions    },
+  { "tactical",   TacticalPositions   },
+  { NULL, NULL }
+};
+
+
+// BenchResults holds, for each position, the nodes searched and the time
+// in msec of each run. Nodes are the same at every run when searching with
+// one thread, the sum of those of the first run is the bench signature.
+
+struct BenchResults {
+
+  BenchResults() : runs(0) {}
+  BenchResults(size_t positions, int r) : runs(r), nodes(positions, vector<int64_t>(r)), times(positions, vector<int>(r)) {}
+
+  int64_t total_nodes(int run) const;
+  int64_t signature() const { return total_nodes(0); }
+  double nps(size_t pos, int run) const;
+  double total_nps(int run) const;
+
+  int runs;
+  vector<vector<int64_t> > nodes;
+  vector<vector<int> > times;
+};
+
+int64_t BenchResults::total_nodes(int run) const {
+
+  int64_t sum = 0;
+
+  for (size_t i = 0; i < nodes.size(); i++)
+      sum += nodes[i][run];
+
+  return sum;
+}
+
+double BenchResults::nps(size_t pos, int run) const {
+
+  return nodes[pos][run] * 1000.0 / Max(times[pos][run], 1);
+}
+
+double BenchResults::total_nps(int run) const {
+
+  int t = 0;
+
+  for (size_t i = 0; i < times.size(); i++)
+      t += times[i][run];
+
+  return total_nodes(run) * 1000.0 / Max(t, 1);
+}
+
+
+// load_positions() fills fenList with the default positions, the ones of a
+// built-in category or of all of them, or the ones read from fenFile. The
+// category of each position, or the file name, is stored in categoryList.
+
+static void load_positions(const string& fenFile, vector<string>& fenList, vector<string>& categoryList) {
+
+  if (fenFile == "default")
+  {
+      for (int i = 0; !Defaults[i].empty(); i++)
+          fenList.push_back(Defaults[i]);
+
+      categoryList.resize(fenList.size(), fenFile);
+      return;
+  }
+
+  for (const BenchCategory* c = Categories; c->name; c++)
+      if (fenFile == "all" || fenFile == c->name)
+          for (int i = 0; !c->positions[i].empty(); i++)
+          {
+              fenList.push_back(c->positions[i]);
+              categoryList.push_back(c->name);
+          }
+
+  if (!fenList.empty())
+      return;
+
+  string fen;
+  ifstream f(fenFile.c_str());
+
+  if (!f.is_open())
+  {
+      cerr << "Unable to open FEN file " << fenFile << endl;
+      exit(EXIT_FAILURE);
+  }
+
+  while (getline(f, fen))
+      if (!fen.empty())
+          fenList.push_back(fen);
+
+  categoryList.resize(fenList.size(), fenFile);
+  f.close();
+}
+
+
+// do_undo_moves() is a microbenchmark of the board update code: it makes
+// and retracts each legal move of the position the given number of times
+// and returns the number of do_move()/undo_move() pairs done.
+
+static int64_t do_undo_moves(Position& pos, int reps) {
+
+  MoveStack mlist[MAX_MOVES];
+  MoveStack* last = generate<MV_LEGAL>(pos, mlist);
+  CheckInfo ci(pos);
+  StateInfo st;
+  int64_t cnt = 0;
+
+  for (int r = 0; r < reps; r++)
+      for (MoveStack* cur = mlist; cur != last; cur++, cnt++)
+      {
+          pos.do_move(cur->move, st, ci, pos.move_gives_check(cur->move, ci));
+          pos.undo_move(cur->move);
+      }
+
+  return cnt;
+}
+
+
+// collect_moves() fills the pool with the legal moves of all the given
+// positions. Most of them are not legal in a different position, like the
+// TT moves and killers that the search has to validate.
+
+static void collect_moves(const vector<string>& fenList, vector<Move>& pool) {
+
+  MoveStack mlist[MAX_MOVES];
+
+  for (size_t i = 0; i < fenList.size(); i++)
+  {
+      Position pos(fenList[i], false, 0);
+      MoveStack* last = generate<MV_LEGAL>(pos, mlist);
+
+      for (MoveStack* cur = mlist; cur != last; cur++)
+          pool.push_back(cur->move);
+  }
+}
+
+
+// validate_moves() is a microbenchmark of move_is_pseudo_legal(): it checks
+// each move of the pool against the position the given number of times and
+// returns the number of checks done. The moves found valid are added to
+// the accepted counter, that must not change when the code is modified.
+
+static int64_t validate_moves(const Position& pos, const vector<Move>& pool, int reps, int64_t& accepted) {
+
+  int64_t cnt = 0;
+
+  for (int r = 0; r < reps; r++)
+      for (size_t i = 0; i < pool.size(); i++, cnt++)
+          if (pos.move_is_pseudo_legal(pool[i]))
+              accepted++;
+
+  return cnt;
+}
+
+
+// print_categories() prints, for each category of positions, the total
+// nodes and time of the first run, the speed and the average time spent
+// on a position, that is the time to depth when limited by depth.
+
+static void print_categories(const vector<string>& categoryList, const BenchResults& r) {
+
+  vector<string> names;
+
+  for (size_t i = 0; i < categoryList.size(); i++)
+      if (find(names.begin(), names.end(), categoryList[i]) == names.end())
+          names.push_back(categoryList[i]);
+
+  cerr << "Category\tPositions\tNodes\t\tTime (ms)\tNodes/second\tTime/position (ms)" << endl;
+
+  for (size_t c = 0; c < names.size(); c++)
+  {
+      int64_t nodes = 0;
+      int time = 0, cnt = 0;
+
+      for (size_t i = 0; i < categoryList.size(); i++)
+          if (categoryList[i] == names[c])
+          {
+              nodes += r.nodes[i][0];
+              time += r.times[i][0];
+              cnt++;
+          }
+
+      cerr << names[c] << (names[c].size() < 8 ? "\t\t" : "\t") << cnt << "\t\t" << nodes << "\t\t" << time
+           << "\t\t" << int(nodes * 1000 / Max(time, 1)) << "\t\t" << time / cnt << endl;
+  }
+  cerr << endl;
+}
+
+
+// save_results() writes the results to a file: a header with the signature
+// and the number of runs, then a line per position with the nodes and the
+// time of each run, in pairs.
+
+static void save_results(const string& fileName, const BenchResults& r) {
+
+  ofstream f(fileName.c_str());
+
+  f << "signature " << r.signature() << "\nruns " << r.runs << endl;
+
+  for (size_t i = 0; i < r.nodes.size(); i++)
+  {
+      for (int j = 0; j < r.runs; j++)
+          f << (j ? " " : "") << r.nodes[i][j] << ' ' << r.times[i][j];
+
+      f << endl;
+  }
+}
+
+
+// load_results() reads a file written by save_results()
+
+static bool load_results(const string& fileName, BenchResults& r) {
+
+  ifstream f(fileName.c_str());
+  string token;
+  int64_t signature, n;
+
+  if (!(f >> token >> signature >> token >> r.runs) || r.runs < 1)
+      return false;
+
+  while (f >> n)
+  {
+      r.nodes.push_back(vector<int64_t>(r.runs));
+      r.times.push_back(vector<int>(r.runs));
+
+      for (int j = 0; j < r.runs; j++)
+          if (   (j && !(f >> n))
+              || !(f >> r.times.back()[j]))
+              return false;
+          else
+              r.nodes.back()[j] = n;
+  }
+  return r.signature() == signature;
+}
+
+
+// speed_ratio() returns the ratio of the mean speeds of the current and
+// baseline samples and the half width of its 95% confidence interval, from
+// the relative standard errors of the two means. The interval is zero when
+// a side has a single sample.
+
+static double speed_ratio(const vector<double>& cur, const vector<double>& base, double* halfWidth) {
+
+  double mean[2] = { 0, 0 }, relErr2[2] = { 0, 0 };
+  const vector<double>* x[2] = { &cur, &base };
+
+  for (int k = 0; k < 2; k++)
+  {
+      size_t n = x[k]->size();
+
+      for (size_t i = 0; i < n; i++)
+          mean[k] += (*x[k])[i] / n;
+
+      if (n < 2)
+          continue;
+
+      double var = 0;
+
+      for (size_t i = 0; i < n; i++)
+          var += ((*x[k])[i] - mean[k]) * ((*x[k])[i] - mean[k]) / (n - 1);
+
+      relErr2[k] = var / n / (mean[k] * mean[k]);
+  }
+
+  double ratio = mean[0] / mean[1];
+  *halfWidth = 1.96 * ratio * sqrt(relErr2[0] + relErr2[1]);
+  return ratio;
+}
+
+
+// compare_results() prints the speed ratios with the baseline, per position
+// and in total, and the final verdict: faster or slower when the confidence
+// interval of the total ratio excludes 1, and whether the node counts, that
+// is the behaviour of the search, have changed.
+
+static void compare_results(const BenchResults& cur, const BenchResults& base) {
+
+  bool samePositions = (cur.nodes.size() == base.nodes.size());
+  bool changed = !samePositions || cur.signature() != base.signature();
+  vector<double> c, b;
+  double ratio, hw;
+
+  cerr << "\nCurrent/baseline speed, 95% confidence interval:" << endl;
+
+  for (size_t i = 0; samePositions && i < cur.nodes.size(); i++)
+  {
+      c.clear();
+      b.clear();
+
+      for (int j = 0; j < cur.runs; j++)
+          c.push_back(cur.nps(i, j));
+
+      for (int j = 0; j < base.runs; j++)
+          b.push_back(base.nps(i, j));
+
+      ratio = speed_ratio(c, b, &hw);
+
+      cerr << "Position " << i + 1 << "\t: " << ratio << " [" << ratio - hw << ", " << ratio + hw << "]"
+           << (cur.nodes[i][0] != base.nodes[i][0] ? "  nodes changed" : "") << endl;
+  }
+
+  c.clear();
+  b.clear();
+
+  for (int j = 0; j < cur.runs; j++)
+      c.push_back(cur.total_nps(j));
+
+  for (int j = 0; j < base.runs; j++)
+      b.push_back(base.total_nps(j));
+
+  ratio = speed_ratio(c, b, &hw);
+
+  string speed =  cur.runs < 2 || base.runs < 2 ? "unknown (at least two runs are needed)"
+                : ratio - hw > 1 ? "faster"
+                : ratio + hw < 1 ? "slower" : "same";
+
+  cerr << "Total\t\t: " << ratio << " [" << ratio - hw << ", " << ratio + hw << "]"
+       << "\n\nVerdict: " << speed << ", behaviour changed: " << (changed ? "yes" : "no")
+       << "\n(signature " << cur.signature() << ", baseline " << base.signature() << ")" << endl << endl;
+}
+
+
 /// benchmark() runs a simple benchmark by letting Stockfish analyze a set
-/// of positions for a given limit each.  There are five parameters; the
-/// transposition table size, the number of search threads that should
+/// of positions for a given limit each.  There are up to twelve parameters;
+/// the transposition table size, the number of search threads that should
 /// be used, the limit value spent for each position (optional, default
 /// is ply 12), an optional file name where to look for positions in fen
-/// format (default are the BenchmarkPositions defined above) and the type
-/// of the limit value: depth (default), time in secs or number of nodes.
-/// The analysis is written to a file named bench.txt.
+/// format (default are the BenchmarkPositions defined above) or the name of
+/// a built-in category: "opening", "middlegame", "endgame", "tactical", or
+/// "all" of them with a report per category, and the type of the limit
+/// value: depth (default), time in secs, number of nodes, perft depth,
+/// "domove" to time do_move()/undo_move() of each legal move repeated limit
+/// times, reporting also the size of the board representation, or
+/// "pseudolegal" to time the validation of the moves of all the positions
+/// against each one, limit times, or "mate" to run the mate solver of "go
+/// mate" with limit as the number of moves.
+/// An optional network weights file can be given to compare the speed of
+/// the network evaluation with the hand-crafted one ("none" to skip it).
+/// Then the number of runs over the positions, each from an empty TT, the
+/// name of a baseline results file to compare with ("none" to skip it), the
+/// size in MB of the shared pawn hash table, 0 for per-thread tables,
+/// whether the split parameters are adapted during the run (true/false,
+/// false by default, as the UCI option), whether the attack tables are
+/// replicated on each NUMA node (true/false) and the name of a file where
+/// the results, of the network pass if any, are written ("none" to skip it).
+/// The baseline is read before the run, so it can be the same file.
 
 void benchmark(int argc, char* argv[]) {
 
-  vector<string> fenList;
+  vector<string> fenList, categoryList;
   SearchLimits limits;
-  int64_t totalNodes;
+  BenchResults results;
+  int64_t totalNodes, ttProbes, ttHits, pawnProbes, pawnHits;
   int time;
 
-  // Load default positions
-  for (int i = 0; !Defaults[i].empty(); i++)
-      fenList.push_back(Defaults[i]);
-
   // Assign default values to missing arguments
   string ttSize  = argc > 2 ? argv[2] : "128";
   string threads = argc > 3 ? argv[3] : "1";
   string valStr  = argc > 4 ? argv[4] : "12";
   string fenFile = argc > 5 ? argv[5] : "default";
   string valType = argc > 6 ? argv[6] : "depth";
+  string evalFile = argc > 7 && string(argv[7]) != "none" ? argv[7] : "";
+  int runs        = argc > 8 ? Max(atoi(argv[8]), 1) : 1;
+  string baseFile = argc > 9 && string(argv[9]) != "none" ? argv[9] : "";
+  string pawnHash = argc > 10 ? argv[10] : "0";
+  string adaptiveSplit = argc > 11 ? argv[11] : "false";
+  string numaTables = argc > 12 ? argv[12] : "false";
+  string resultsFile = argc > 13 && string(argv[13]) != "none" ? argv[13] : "";
+  BenchResults base;
+
+  if (!baseFile.empty() && !load_results(baseFile, base))
+  {
+      cerr << "Unable to read baseline results file " << baseFile << endl;
+      exit(EXIT_FAILURE);
+  }
 
   Options["Hash"].set_value(ttSize);
   Options["Threads"].set_value(threads);
+  Options["Shared Pawn Hash"].set_value(pawnHash);
+  Options["Adaptive Split Parameters"].set_value(adaptiveSplit);
+  Options["NUMA Replicated Tables"].set_value(numaTables);
   Options["OwnBook"].set_value("false");
 
   // Search should be limited by nodes, time or depth ?
@@ -87,67 +580,302 @@ void benchmark(int argc, char* argv[]) {
   else
       limits.maxDepth = atoi(valStr.c_str());
 
-  // Do we need to load positions from a given FEN file ?
-  if (fenFile != "default")
-  {
-      string fen;
-      ifstream f(fenFile.c_str());
+  // Do we need to load positions from a given FEN file or category ?
+  load_positions(fenFile, fenList, categoryList);
 
-      if (f.is_open())
-      {
-          fenList.clear();
+  // Ok, let's start the benchmark ! When a network file is given positions
+  // are searched twice, first with the hand-crafted evaluation and then with
+  // the network one, so that the speed of the two backends can be compared.
+  int passes = (   evalFile.empty() || valType == "perft" || valType == "domove"
+                || valType == "pseudolegal" || valType == "mate" ? 1 : 2);
+  int nps[2] = { 0, 0 };
+  vector<Move> movePool;
+  int64_t accepted = 0;
 
-          while (getline(f, fen))
-              if (!fen.empty())
-                  fenList.push_back(fen);
+  if (valType == "pseudolegal")
+      collect_moves(fenList, movePool);
 
-          f.close();
+  for (int pass = 0; pass < passes; pass++)
+  {
+      if (passes > 1)
+      {
+          Options["Use NN Eval"].set_value(pass ? "true" : "false");
+          Options["NN Weights File"].set_value(evalFile);
+          read_evaluation_uci_options(WHITE);
+
+          if (pass && !nnue_is_loaded())
+          {
+              cerr << "Unable to load network file " << evalFile << endl;
+              exit(EXIT_FAILURE);
+          }
       }
-      else
+
+      results = BenchResults(fenList.size(), runs);
+      totalNodes = ttProbes = ttHits = pawnProbes = pawnHits = 0;
+      time = get_system_time();
+
+      for (int run = 0; run < runs; run++)
       {
-          cerr << "Unable to open FEN file " << fenFile << endl;
-          exit(EXIT_FAILURE);
+          // Each run starts from an empty TT, so that all the runs search
+          // exactly the same trees.
+          Options["Clear Hash"].set_value("true");
+
+          for (size_t i = 0; i < fenList.size(); i++)
+          {
+              Move moves[] = { MOVE_NONE };
+              Position pos(fenList[i], false, 0);
+              int t = get_system_time();
+
+              cerr << "\nBench position: " << i + 1 << '/' << fenList.size();
+
+              if (runs > 1)
+                  cerr << ", run " << run + 1 << '/' << runs;
+
+              cerr << endl;
+
+              if (valType == "perft")
+              {
+                  results.nodes[i][run] = perft(pos, limits.maxDepth * ONE_PLY);
+
+                  cerr << "\nPerft " << limits.maxDepth << " nodes counted: " << results.nodes[i][run] << endl;
+              }
+              else if (valType == "domove")
+                  results.nodes[i][run] = do_undo_moves(pos, limits.maxDepth);
+              else if (valType == "pseudolegal")
+                  results.nodes[i][run] = validate_moves(pos, movePool, limits.maxDepth, accepted);
+              else if (valType == "mate")
+              {
+                  Move pv[2 * MaxMateMoves];
+                  MateCommand command;
+                  int mate = mate_search(pos, limits.maxDepth, SearchLimits(), moves, pv, &results.nodes[i][run], &command);
+
+                  if (command == MATE_QUIT)
+                      break;
+
+                  if (mate)
+                      cerr << "Mate in " << mate << ", first move " << move_to_uci(pv[0], false) << endl;
+                  else
+                      cerr << "No mate in " << limits.maxDepth << endl;
+              }
+              else
+              {
+                  if (!think(pos, limits, moves))
+                      break;
+
+                  results.nodes[i][run] = pos.nodes_searched();
+
+                  for (int j = 0; j < Threads.size(); j++)
+                  {
+                      ttProbes += Threads[j].ttProbes;
+                      ttHits += Threads[j].ttHits;
+                      pawnProbes += Threads[j].pawnTable.probes;
+                      pawnHits += Threads[j].pawnTable.hits;
+                  }
+              }
+
+              results.times[i][run] = get_system_time() - t;
+              totalNodes += results.nodes[i][run];
+          }
       }
+
+      time = get_system_time() - time;
+      nps[pass] = (int)(totalNodes / (time / 1000.0));
+
+      cerr << "\n===============================";
+
+      if (passes > 1)
+          cerr << "\nEvaluation      : " << (pass ? "network" : "hand-crafted");
+
+      cerr << "\nTotal time (ms) : " << time
+           << "\nNodes searched  : " << results.signature()
+           << "\nNodes/second    : " << nps[pass] << endl;
+
+      if (ttProbes)
+          cerr << "TT hit rate (%) : " << 100.0 * ttHits / ttProbes << endl;
+
+      if (pawnProbes)
+          cerr << "Pawn hit rate (%): " << 100.0 * pawnHits / pawnProbes << endl;
+
+      cerr << endl;
+
+      if (valType == "domove")
+          cerr << "Position size   : " << sizeof(Position)
+               << "\nStateInfo size  : " << sizeof(StateInfo)
+               << "\nBoard size      : " << sizeof(Position) - sizeof(StateInfo)
+               << "\nDo/undo per sec : " << nps[pass] << endl << endl;
+
+      if (valType == "pseudolegal")
+          cerr << "Move pool size  : " << movePool.size()
+               << "\nMoves accepted  : " << accepted
+               << "\nChecks per sec  : " << nps[pass] << endl << endl;
+
+      if (fenFile == "all")
+          print_categories(categoryList, results);
   }
 
-  // Ok, let's start the benchmark !
-  totalNodes = 0;
-  time = get_system_time();
+  if (passes > 1)
+      cerr << "Network/hand-crafted NPS ratio: " << double(nps[1]) / nps[0] << endl << endl;
 
-  for (size_t i = 0; i < fenList.size(); i++)
+  // Heap allocations made by the search, when compiled with tracking
+  alloc_print_report();
+
+  if (!resultsFile.empty())
+      save_results(resultsFile, results);
+
+  if (!baseFile.empty())
+      compare_results(results, base);
+
+  // MS Visual C++ debug window always unconditionally closes when program
+  // exits, this is bad because we want to read results before.
+  #if (defined(WINDOWS) || defined(WIN32) || defined(WIN64))
+  cerr << "Press any key to exit" << endl;
+  cin >> time;
+  #endif
+}
+
+
+/// batch_benchmark() measures the speed of the interleaved batch search. The
+/// parameters are the transposition table size, the search depth in plies,
+/// the number of searches kept in flight by the thread and an optional file
+/// of positions in fen format. Positions are searched first one at a time
+/// and then interleaved, each pass starting from an empty TT, so that the
+/// two throughputs can be compared.
+
+void batch_benchmark(int argc, char* argv[]) {
+
+  vector<string> fenList, categoryList;
+  vector<BatchResult> results[2];
+
+  string ttSize  = argc > 2 ? argv[2] : "128";
+  int depth      = argc > 3 ? atoi(argv[3]) : 5;
+  int width      = argc > 4 ? atoi(argv[4]) : 4;
+  string fenFile = argc > 5 ? argv[5] : "default";
+
+  load_positions(fenFile, fenList, categoryList);
+
+  Options["Hash"].set_value(ttSize);
+  read_evaluation_uci_options(WHITE);
+  Threads.init_hash_tables();
+  TT.set_size(Options["Hash"].value<int>());
+
+  width = Max(width, 1);
+
+  for (int pass = 0; pass < 2; pass++)
   {
-      Move moves[] = { MOVE_NONE };
-      Position pos(fenList[i], false, 0);
+      int w = pass ? width : 1;
+      int64_t totalNodes = 0;
 
-      cerr << "\nBench position: " << i + 1 << '/' << fenList.size() << endl;
+      TT.clear();
+      TT.new_search();
 
-      if (valType == "perft")
-      {
-          int64_t cnt = perft(pos, limits.maxDepth * ONE_PLY);
-          totalNodes += cnt;
+      int time = get_system_time();
+      batch_search(fenList, Depth(depth * ONE_PLY), w, results[pass]);
+      time = Max(get_system_time() - time, 1);
+
+      for (size_t i = 0; i < results[pass].size(); i++)
+          totalNodes += results[pass][i].nodes;
+
+      cerr << "\n==============================="
+           << "\nSearches in flight : " << w
+           << "\nTotal time (ms)    : " << time
+           << "\nNodes searched     : " << totalNodes
+           << "\nNodes/second       : " << int(totalNodes / (time / 1000.0))
+           << "\nPositions/second   : " << fenList.size() * 1000.0 / time << endl;
+  }
+
+  // The searches share the TT, so interleaving can change the replacement
+  // pattern and, rarely, the result of a search.
+  int changed = 0;
+
+  for (size_t i = 0; i < fenList.size(); i++)
+      if (   results[0][i].move != results[1][i].move
+          || results[0][i].value != results[1][i].value)
+          changed++;
+
+  cerr << "\nResults changed by interleaving: " << changed << '/' << fenList.size() << endl << endl;
+}
+
+
+/// cluster_benchmark() measures the speedup of the cluster mode against a
+/// single process. The parameters are the number of worker processes, the
+/// search depth in plies, the transposition table size and an optional file
+/// of positions in fen format. Positions are searched to the given depth
+/// first alone and then with the workers, started on this host and linked
+/// through the loopback interface, and the two times to depth are compared.
+/// Each process should have its own core for the speedup to be meaningful.
 
-          cerr << "\nPerft " << limits.maxDepth << " nodes counted: " << cnt << endl;
+void cluster_benchmark(int argc, char* argv[]) {
+
+  vector<string> fenList, categoryList;
+  vector<int> times[2];
+  SearchLimits limits;
+
+  int workers    = argc > 2 ? Max(atoi(argv[2]), 1) : 2;
+  string depth   = argc > 3 ? argv[3] : "12";
+  string ttSize  = argc > 4 ? argv[4] : "128";
+  string fenFile = argc > 5 ? argv[5] : "default";
+
+  Options["Hash"].set_value(ttSize);
+  Options["Threads"].set_value("1");
+  Options["OwnBook"].set_value("false");
+  limits.maxDepth = atoi(depth.c_str());
+
+  load_positions(fenFile, fenList, categoryList);
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+      int64_t totalNodes = 0;
+      int time = 0;
+
+      if (pass && cluster_spawn_workers(workers) < workers)
+      {
+          cerr << "Unable to start " << workers << " cluster workers" << endl;
+          cluster_shutdown();
+          exit(EXIT_FAILURE);
       }
-      else
+
+      for (size_t i = 0; i < fenList.size(); i++)
       {
+          Move moves[] = { MOVE_NONE };
+          Position pos(fenList[i], false, 0);
+
+          cerr << "\nCluster position: " << i + 1 << '/' << fenList.size()
+               << ", workers " << (pass ? workers : 0) << endl;
+
+          Options["Clear Hash"].set_value("true");
+
+          int t = get_system_time();
+
           if (!think(pos, limits, moves))
               break;
 
+          times[pass].push_back(Max(get_system_time() - t, 1));
+          time += times[pass].back();
           totalNodes += pos.nodes_searched();
       }
+
+      cerr << "\n==============================="
+           << "\nCluster workers    : " << (pass ? workers : 0)
+           << "\nTotal time (ms)    : " << time
+           << "\nCoordinator nodes  : " << totalNodes
+           << "\nNodes/second       : " << int(totalNodes / (Max(time, 1) / 1000.0)) << endl;
   }
 
-  time = get_system_time() - time;
+  cluster_shutdown();
 
-  cerr << "\n==============================="
-       << "\nTotal time (ms) : " << time
-       << "\nNodes searched  : " << totalNodes
-       << "\nNodes/second    : " << (int)(totalNodes / (time / 1000.0)) << endl << endl;
+  // Ratio of the single process and cluster times to depth, the speedup
+  cerr << "\nPosition\tSingle (ms)\tCluster (ms)\tSpeedup" << endl;
 
-  // MS Visual C++ debug window always unconditionally closes when program
-  // exits, this is bad because we want to read results before.
-  #if (defined(WINDOWS) || defined(WIN32) || defined(WIN64))
-  cerr << "Press any key to exit" << endl;
-  cin >> time;
-  #endif
+  int t0 = 0, t1 = 0;
+
+  for (size_t i = 0; i < times[1].size(); i++)
+  {
+      t0 += times[0][i];
+      t1 += times[1][i];
+
+      cerr << i + 1 << "\t\t" << times[0][i] << "\t\t" << times[1][i]
+           << "\t\t" << double(times[0][i]) / times[1][i] << endl;
+  }
+
+  cerr << "Total\t\t" << t0 << "\t\t" << t1 << "\t\t" << double(t0) / Max(t1, 1) << endl << endl;
 }
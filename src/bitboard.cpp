@@ -17,10 +17,12 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cstring>
 #include <iostream>
 
 #include "bitboard.h"
 #include "bitcount.h"
+#include "misc.h"
 
 #if defined(IS_64BIT)
 
@@ -166,6 +168,9 @@ Bitboard BMask[64];
 int BAttackIndex[64];
 Bitboard BAttacks[0x1480];
 
+THREAD_LOCAL const Bitboard* ThreadRAttacks = RAttacks;
+THREAD_LOCAL const Bitboard* ThreadBAttacks = BAttacks;
+
 Bitboard SetMaskBB[65];
 Bitboard ClearMaskBB[65];
 
@@ -185,6 +190,11 @@ Bitboard BishopPseudoAttacks[64];
 Bitboard RookPseudoAttacks[64];
 Bitboard QueenPseudoAttacks[64];
 
+// Destination squares of the non-promotion moves of a piece on an empty
+// board, indexed by piece and origin square. Pawn entries include captures
+// and double pushes.
+Bitboard PseudoMovesBB[16][64];
+
 uint8_t BitCount8Bit[256];
 
 
@@ -194,6 +204,7 @@ namespace {
   void init_step_attacks();
   void init_pseudo_attacks();
   void init_between_bitboards();
+  void init_pseudo_moves();
   Bitboard index_to_bitboard(int index, Bitboard mask);
   Bitboard sliding_attacks(int sq, Bitboard occupied, int deltas[][2],
                            int fmin, int fmax, int rmin, int rmax);
@@ -312,6 +323,76 @@ void init_bitboards() {
   init_sliding_attacks(BAttacks, BAttackIndex, BMask, BShift, BMult, bishopDeltas);
   init_pseudo_attacks();
   init_between_bitboards();
+  init_pseudo_moves();
+}
+
+
+namespace {
+
+  // Copies of RAttacks followed by BAttacks, one per NUMA node
+  const size_t ReplicaSize = sizeof(RAttacks) + sizeof(BAttacks);
+
+  Bitboard* Replicas[MaxNumaNodes];
+  int ReplicaCount;
+}
+
+
+/// replicate_attack_tables() makes a copy of the magic attack tables in the
+/// memory of each NUMA node, or frees the copies when enable is false. Read
+/// only tables are never invalidated, but the rook one is too large to stay
+/// in the caches, so threads on a remote node would pay a cross-node miss at
+/// many lookups. It must be called when no other thread is searching, each
+/// thread picks its copy with use_local_attack_tables().
+
+void replicate_attack_tables(bool enable) {
+
+  int nodes = (enable ? Min(numa_node_count(), MaxNumaNodes) : 0);
+
+  if (nodes == ReplicaCount)
+      return;
+
+  // Our own pointers could refer to a copy we are going to free
+  ThreadRAttacks = RAttacks;
+  ThreadBAttacks = BAttacks;
+
+  for (int i = 0; i < ReplicaCount; i++)
+      free_numa(Replicas[i], ReplicaSize);
+
+  for (ReplicaCount = 0; ReplicaCount < nodes; ReplicaCount++)
+  {
+      Bitboard* r = Replicas[ReplicaCount] = (Bitboard*)alloc_on_node(ReplicaSize, ReplicaCount);
+
+      if (!r)
+      {
+          std::cerr << "Failed to allocate attack tables on NUMA node " << ReplicaCount << std::endl;
+          exit(EXIT_FAILURE);
+      }
+      memcpy(r, RAttacks, sizeof(RAttacks));
+      memcpy(r + sizeof(RAttacks) / sizeof(Bitboard), BAttacks, sizeof(BAttacks));
+  }
+}
+
+
+/// use_local_attack_tables() points the lookups of the calling thread to the
+/// copy of the attack tables of the NUMA node it is running on, or to the
+/// global tables when they are not replicated. Threads are not bound to a
+/// node, so it is called each time a thread starts a search. Returns the
+/// node, 0 when not replicated.
+
+int use_local_attack_tables() {
+
+  int node = (ReplicaCount ? current_numa_node() : 0);
+
+  if (node >= ReplicaCount)
+  {
+      ThreadRAttacks = RAttacks;
+      ThreadBAttacks = BAttacks;
+      return 0;
+  }
+
+  ThreadRAttacks = Replicas[node];
+  ThreadBAttacks = Replicas[node] + sizeof(RAttacks) / sizeof(Bitboard);
+  return node;
 }
 
 namespace {
@@ -483,4 +564,30 @@ namespace {
             }
   }
 
+  void init_pseudo_moves() {
+
+    for (Square s = SQ_A1; s <= SQ_H8; s++)
+    {
+        for (Color c = WHITE; c <= BLACK; c++)
+        {
+            Piece pawn = Piece(WP + 8 * c);
+            Square push = (c == WHITE ? DELTA_N : DELTA_S);
+
+            if (relative_rank(c, s) == RANK_1 || relative_rank(c, s) >= RANK_7)
+                continue;
+
+            PseudoMovesBB[pawn][s] = StepAttacksBB[pawn][s] | SetMaskBB[s + push];
+
+            if (relative_rank(c, s) == RANK_2)
+                set_bit(&PseudoMovesBB[pawn][s], s + push + push);
+        }
+
+        PseudoMovesBB[WN][s] = PseudoMovesBB[BN][s] = StepAttacksBB[WN][s];
+        PseudoMovesBB[WB][s] = PseudoMovesBB[BB][s] = BishopPseudoAttacks[s];
+        PseudoMovesBB[WR][s] = PseudoMovesBB[BR][s] = RookPseudoAttacks[s];
+        PseudoMovesBB[WQ][s] = PseudoMovesBB[BQ][s] = QueenPseudoAttacks[s];
+        PseudoMovesBB[WK][s] = PseudoMovesBB[BK][s] = StepAttacksBB[WK][s];
+    }
+  }
+
 }
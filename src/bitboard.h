@@ -21,6 +21,10 @@
 #if !defined(BITBOARD_H_INCLUDED)
 #define BITBOARD_H_INCLUDED
 
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#endif
+
 #include "types.h"
 
 const Bitboard EmptyBoardBB = 0;
@@ -82,8 +86,19 @@ extern Bitboard BishopPseudoAttacks[64];
 extern Bitboard RookPseudoAttacks[64];
 extern Bitboard QueenPseudoAttacks[64];
 
+extern Bitboard PseudoMovesBB[16][64];
+
 extern uint8_t BitCount8Bit[256];
 
+/// Magic attack tables are looked up through thread local pointers, to the
+/// tables above or to their copy in the memory of the NUMA node the thread
+/// runs on, see replicate_attack_tables().
+
+const int MaxNumaNodes = 16;
+
+extern THREAD_LOCAL const Bitboard* ThreadRAttacks;
+extern THREAD_LOCAL const Bitboard* ThreadBAttacks;
+
 
 /// Functions for testing whether a given bit is set in a bitboard, and for
 /// setting and clearing bits.
@@ -181,25 +196,25 @@ inline Bitboard in_front_bb(Color c, Square s) {
 
 inline Bitboard rook_attacks_bb(Square s, Bitboard blockers) {
   Bitboard b = blockers & RMask[s];
-  return RAttacks[RAttackIndex[s] + ((b * RMult[s]) >> RShift[s])];
+  return ThreadRAttacks[RAttackIndex[s] + ((b * RMult[s]) >> RShift[s])];
 }
 
 inline Bitboard bishop_attacks_bb(Square s, Bitboard blockers) {
   Bitboard b = blockers & BMask[s];
-  return BAttacks[BAttackIndex[s] + ((b * BMult[s]) >> BShift[s])];
+  return ThreadBAttacks[BAttackIndex[s] + ((b * BMult[s]) >> BShift[s])];
 }
 
 #else // if !defined(IS_64BIT)
 
 inline Bitboard rook_attacks_bb(Square s, Bitboard blockers) {
   Bitboard b = blockers & RMask[s];
-  return RAttacks[RAttackIndex[s] +
+  return ThreadRAttacks[RAttackIndex[s] +
         (unsigned(int(b) * int(RMult[s]) ^ int(b >> 32) * int(RMult[s] >> 32)) >> RShift[s])];
 }
 
 inline Bitboard bishop_attacks_bb(Square s, Bitboard blockers) {
   Bitboard b = blockers & BMask[s];
-  return BAttacks[BAttackIndex[s] +
+  return ThreadBAttacks[BAttackIndex[s] +
         (unsigned(int(b) * int(BMult[s]) ^ int(b >> 32) * int(BMult[s] >> 32)) >> BShift[s])];
 }
 
@@ -210,6 +225,98 @@ inline Bitboard queen_attacks_bb(Square s, Bitboard blockers) {
 }
 
 
+/// sliding_attacks_ks() returns the union of the attacks of all the sliders
+/// of type Pt (BISHOP, ROOK or QUEEN) in the given set, computed with
+/// Kogge-Stone occluded fills instead of magic table lookups, so without any
+/// memory traffic. With AVX2 four directions are filled in parallel, one in
+/// each 64 bit lane, otherwise one direction at a time. Wrap around the board
+/// edge is avoided by masking out the file opposite to the step direction.
+
+#if defined(USE_AVX2)
+
+inline __m256i shift_lanes_ks(__m256i b, __m256i left, __m256i right) {
+  return _mm256_or_si256(_mm256_sllv_epi64(b, left), _mm256_srlv_epi64(b, right));
+}
+
+// Shift counts of 64 or more give zero, so each lane shifts only one way
+inline __m256i occluded_fill_ks(__m256i gen, __m256i pro, __m256i left, __m256i right, __m256i mask) {
+
+  const __m256i left2 = _mm256_add_epi64(left, left), right2 = _mm256_add_epi64(right, right);
+  const __m256i left4 = _mm256_add_epi64(left2, left2), right4 = _mm256_add_epi64(right2, right2);
+
+  pro = _mm256_and_si256(pro, mask);
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift_lanes_ks(gen, left, right)));
+  pro = _mm256_and_si256(pro, shift_lanes_ks(pro, left, right));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift_lanes_ks(gen, left2, right2)));
+  pro = _mm256_and_si256(pro, shift_lanes_ks(pro, left2, right2));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift_lanes_ks(gen, left4, right4)));
+  return _mm256_and_si256(shift_lanes_ks(gen, left, right), mask);
+}
+
+template<PieceType Pt>
+inline Bitboard sliding_attacks_ks(Bitboard sliders, Bitboard occupied) {
+
+  const __m256i gen = _mm256_set1_epi64x(sliders);
+  const __m256i pro = _mm256_set1_epi64x(~occupied);
+  __m256i b = _mm256_setzero_si256();
+
+  // Lanes are north, east, south and west
+  if (Pt != BISHOP)
+      b = occluded_fill_ks(gen, pro, _mm256_set_epi64x(64, 64, 1, 8),
+                                     _mm256_set_epi64x(1, 8, 64, 64),
+                                     _mm256_set_epi64x(~FileHBB, ~0ULL, ~FileABB, ~0ULL));
+
+  // Lanes are north-east, north-west, south-east and south-west
+  if (Pt != ROOK)
+      b = _mm256_or_si256(b, occluded_fill_ks(gen, pro, _mm256_set_epi64x(64, 64, 7, 9),
+                                                         _mm256_set_epi64x(9, 7, 64, 64),
+                                                         _mm256_set_epi64x(~FileHBB, ~FileABB, ~FileHBB, ~FileABB)));
+
+  __m128i r = _mm_or_si128(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+  return Bitboard(_mm_cvtsi128_si64(_mm_or_si128(r, _mm_unpackhi_epi64(r, r))));
+}
+
+#else // if !defined(USE_AVX2)
+
+template<int Delta>
+inline Bitboard shift_ks(Bitboard b) {
+  return Delta > 0 ? b << (Delta & 63) : b >> (-Delta & 63);
+}
+
+template<int Delta>
+inline Bitboard occluded_fill_ks(Bitboard gen, Bitboard pro, Bitboard mask) {
+
+  pro &= mask;
+  gen |= pro & shift_ks<Delta>(gen);
+  pro &= shift_ks<Delta>(pro);
+  gen |= pro & shift_ks<2 * Delta>(gen);
+  pro &= shift_ks<2 * Delta>(pro);
+  gen |= pro & shift_ks<4 * Delta>(gen);
+  return shift_ks<Delta>(gen) & mask;
+}
+
+template<PieceType Pt>
+inline Bitboard sliding_attacks_ks(Bitboard sliders, Bitboard occupied) {
+
+  Bitboard b = EmptyBoardBB;
+
+  if (Pt != BISHOP)
+      b |=  occluded_fill_ks< 8>(sliders, ~occupied, ~EmptyBoardBB)
+          | occluded_fill_ks<-8>(sliders, ~occupied, ~EmptyBoardBB)
+          | occluded_fill_ks< 1>(sliders, ~occupied, ~FileABB)
+          | occluded_fill_ks<-1>(sliders, ~occupied, ~FileHBB);
+
+  if (Pt != ROOK)
+      b |=  occluded_fill_ks< 9>(sliders, ~occupied, ~FileABB)
+          | occluded_fill_ks< 7>(sliders, ~occupied, ~FileHBB)
+          | occluded_fill_ks<-7>(sliders, ~occupied, ~FileABB)
+          | occluded_fill_ks<-9>(sliders, ~occupied, ~FileHBB);
+  return b;
+}
+
+#endif
+
+
 /// squares_between returns a bitboard representing all squares between
 /// two squares.  For instance, squares_between(SQ_C4, SQ_F7) returns a
 /// bitboard with the bits for square d5 and e6 set.  If s1 and s2 are not
@@ -250,6 +357,44 @@ inline Bitboard attack_span_mask(Color c, Square s) {
 }
 
 
+/// Set-wise helpers used to evaluate all pawns at once. shift_forward() moves
+/// every square one rank ahead from the point of view of the given color,
+/// shift_sideways() to both the neighboring files on the same rank. front_fill()
+/// adds all the squares in front of each square along its file, file_fill()
+/// extends each square to its whole file.
+
+template<Color C>
+inline Bitboard shift_forward(Bitboard b) {
+  return C == WHITE ? b << 8 : b >> 8;
+}
+
+inline Bitboard shift_sideways(Bitboard b) {
+  return ((b << 1) & ~FileABB) | ((b >> 1) & ~FileHBB);
+}
+
+template<Color C>
+inline Bitboard front_fill(Bitboard b) {
+
+  if (C == WHITE)
+  {
+      b |= b << 8;
+      b |= b << 16;
+      b |= b << 32;
+  }
+  else
+  {
+      b |= b >> 8;
+      b |= b >> 16;
+      b |= b >> 32;
+  }
+  return b;
+}
+
+inline Bitboard file_fill(Bitboard b) {
+  return front_fill<WHITE>(b) | front_fill<BLACK>(b);
+}
+
+
 /// squares_aligned returns true if the squares s1, s2 and s3 are aligned
 /// either on a straight or on a diagonal line.
 
@@ -297,5 +442,7 @@ extern Square pop_1st_bit(Bitboard* b);
 
 extern void print_bitboard(Bitboard b);
 extern void init_bitboards();
+extern void replicate_attack_tables(bool enable);
+extern int use_local_attack_tables();
 
 #endif // !defined(BITBOARD_H_INCLUDED)
@@ -0,0 +1,951 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cluster.h"
+#include "lock.h"
+#include "misc.h"
+#include "position.h"
+#include "tt.h"
+
+using std::string;
+
+// Global flag tested by the search before sharing an entry, set as soon as
+// this process is part of a cluster.
+bool ClusterEnabled;
+
+#if defined(_WIN32)
+
+bool cluster_listen(const string&, int) {
+
+  std::cout << "info string Cluster mode is not supported on this platform" << std::endl;
+  return false;
+}
+
+bool cluster_connect(const string&, int) {
+
+  std::cerr << "Cluster mode is not supported on this platform" << std::endl;
+  return false;
+}
+
+int cluster_spawn_workers(int) {
+
+  std::cerr << "Cluster mode is not supported on this platform" << std::endl;
+  return 0;
+}
+
+void cluster_shutdown() {}
+bool cluster_start_search(const Position&, const Move[], int, Move[]) { return false; }
+void cluster_iteration(int, Value, const Move[], bool) {}
+void cluster_stop_search(Position&, bool, Move*, Move*) {}
+void cluster_share(Key, Value, ValueType, Depth, Move, Value, Value) {}
+
+#else
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/// All the network traffic is done by a dedicated thread, the search threads
+/// only append the entries to share to an outbox. Messages are text lines:
+/// UCI commands from the coordinator to the workers, UCI output back from the
+/// workers, and "tt" lines carrying transposition table entries both ways,
+/// relayed by the coordinator to the other workers. A worker is just an UCI
+/// engine whose standard input and output are piped to the coordinator link.
+///
+/// Sockets and the worker input pipe are non-blocking: the lines to send are
+/// queued per destination and written when select() reports that the other
+/// side can take them, so that the network thread never blocks, and never
+/// while holding PeersLock.
+
+namespace {
+
+  // An entry waiting in the outbox to be sent to the other processes
+  struct SharedEntry {
+    Key key;
+    Value value, staticValue, staticMargin;
+    ValueType type;
+    Depth depth;
+    Move move;
+  };
+
+  // Result is a completed iteration of a share of the root moves: its depth
+  // and score, the best and ponder moves in UCI notation and, for a worker,
+  // the info line it sent.
+  struct Result {
+    Result() : depth(0), value(VALUE_NONE) {}
+
+    int depth;
+    Value value;
+    string best, ponder, line;
+  };
+
+  // Connection is the link with another process, with its pending input
+  // and output. On the coordinator 'busy' is set from "go" until worker
+  // answers with "bestmove", 'stopped' once it has been sent "stop", after
+  // which its info lines are no longer full iterations, 'nodes' is the last
+  // count it reported and 'results' its iterations, indexed by depth. The
+  // last PV line of an iteration is 'pending' until the worker goes deeper
+  // or answers, as the search can send fail high or fail low lines first.
+  struct Connection {
+    int fd;
+    string in, out;
+    bool busy, stopped;
+    int64_t nodes;
+    std::vector<Result> results;
+    Result pending;
+  };
+
+  const int OutboxSize = 4096;
+  const int PollInterval = 2; // In milliseconds
+  const int StopTimeout = 1000; // In milliseconds
+  const int ConnectTimeout = 5000; // In milliseconds
+
+  // Entries are dropped for a peer that has this much output not yet sent,
+  // UCI commands and output are always queued.
+  const size_t MaxPendingOutput = 1 << 20;
+
+  SharedEntry Outbox[OutboxSize];
+  int OutboxCount;
+  Lock OutboxLock, PeersLock;
+
+  std::vector<Connection> Peers; // Workers on the coordinator, coordinator on a worker
+  std::vector<Result> OwnResults; // Iterations of our share, used only by the search thread
+  std::vector<pid_t> Children; // Workers started by cluster_spawn_workers()
+  string StdinOut; // Commands for the UCI loop of a worker
+  string StdoutIn; // Output of the UCI loop of a worker, up to the last full line
+  int ListenFd = -1, ListenPort, StdinPipe = -1, StdoutPipe = -1;
+  bool IsWorker;
+  volatile bool Searching;
+
+  void start_network_thread();
+  void* network_loop(void*);
+  void handle_line(size_t idx, const string& line);
+  void read_result(Connection& c, const string& line);
+  void commit_result(Connection& c);
+  Value value_from_uci(const string& type, int v);
+  int deepest_result(const std::vector<Result>& results, int maxDepth);
+  bool entry_is_ok(Value v, int t, Depth d, Move m, Value statV, Value statM);
+  void flush_outbox();
+  void send_some(int fd, string& s);
+  void set_non_blocking(int fd);
+  void set_no_delay(int fd);
+}
+
+
+/// cluster_listen() opens the coordinator side of the cluster, accepting
+/// workers on the given TCP port of the given local address from now on,
+/// a port of 0 picks a free one. It is called at each search and does
+/// nothing once the port is open.
+
+bool cluster_listen(const string& bindAddress, int port) {
+
+  if (ListenFd >= 0)
+      return true;
+
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  int yes = 1;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(uint16_t(port));
+
+  if (   fd < 0
+      || inet_pton(AF_INET, bindAddress.c_str(), &addr.sin_addr) != 1
+      || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0
+      || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+      || listen(fd, 16) < 0
+      || getsockname(fd, (struct sockaddr*)&addr, &len) < 0)
+  {
+      std::cout << "info string Unable to listen for cluster workers on "
+                << bindAddress << ":" << port << std::endl;
+      if (fd >= 0)
+          close(fd);
+      return false;
+  }
+
+  // Workers started by us must not inherit the listening socket
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  ListenFd = fd;
+  ListenPort = ntohs(addr.sin_port);
+  start_network_thread();
+  std::cout << "info string Listening for cluster workers on "
+            << bindAddress << ":" << ListenPort << std::endl;
+  return true;
+}
+
+
+/// cluster_connect() turns this process into a worker of the coordinator at
+/// the given address. The standard input and output are redirected to pipes
+/// served by the network thread, so that the normal UCI loop, called next,
+/// talks to the coordinator.
+
+bool cluster_connect(const string& host, int port) {
+
+  struct addrinfo hints, *res, *ai;
+  std::stringstream portStr;
+  int fd = -1, in[2], out[2];
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  portStr << port;
+
+  if (getaddrinfo(host.c_str(), portStr.str().c_str(), &hints, &res) != 0)
+  {
+      std::cerr << "Unable to resolve " << host << std::endl;
+      return false;
+  }
+
+  for (ai = res; ai && fd < 0; ai = ai->ai_next)
+      if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) >= 0
+          && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0)
+      {
+          close(fd);
+          fd = -1;
+      }
+
+  freeaddrinfo(res);
+
+  if (fd < 0 || pipe(in) < 0 || pipe(out) < 0)
+  {
+      std::cerr << "Unable to connect to " << host << ":" << port << std::endl;
+      return false;
+  }
+
+  std::cerr << "Connected to cluster coordinator " << host << ":" << port << std::endl;
+
+  dup2(in[0], STDIN_FILENO);
+  dup2(out[1], STDOUT_FILENO);
+  close(in[0]);
+  close(out[1]);
+  StdinPipe = in[1];
+  StdoutPipe = out[0];
+  IsWorker = true;
+
+  set_non_blocking(StdinPipe);
+  set_non_blocking(fd);
+  set_no_delay(fd);
+
+  Connection c = { fd, "", "", false, false, 0, std::vector<Result>(), Result() };
+  Peers.push_back(c);
+
+  start_network_thread();
+  return true;
+}
+
+
+/// cluster_spawn_workers() starts the given number of worker processes on
+/// this host, connected to us through the loopback interface, and returns
+/// the number of workers connected once all of them are, or after a few
+/// seconds. It is used to measure the cluster speedup, see benchmark.cpp.
+
+int cluster_spawn_workers(int count) {
+
+  if (!cluster_listen("127.0.0.1", 0))
+      return 0;
+
+  char port[16];
+  sprintf(port, "%d", ListenPort);
+
+  for (int i = 0; i < count; i++)
+  {
+      pid_t pid = fork();
+
+      if (pid == 0)
+      {
+          execl("/proc/self/exe", "stockfish", "worker", "127.0.0.1", port, (char*)NULL);
+          _exit(EXIT_FAILURE);
+      }
+      if (pid > 0)
+          Children.push_back(pid);
+  }
+
+  int n = 0, start = get_system_time();
+
+  while (n < count && get_system_time() - start < ConnectTimeout)
+  {
+      usleep(PollInterval * 1000);
+
+      lock_grab(&PeersLock);
+      n = int(Peers.size());
+      lock_release(&PeersLock);
+  }
+  return n;
+}
+
+
+/// cluster_shutdown() sends "quit" to all the workers and waits for the ones
+/// started by cluster_spawn_workers() to exit.
+
+void cluster_shutdown() {
+
+  if (!ClusterEnabled || IsWorker)
+      return;
+
+  lock_grab(&PeersLock);
+
+  for (size_t i = 0; i < Peers.size(); i++)
+      Peers[i].out += "quit\n";
+
+  lock_release(&PeersLock);
+
+  for (size_t i = 0; i < Children.size(); i++)
+  {
+      int start = get_system_time();
+
+      while (waitpid(Children[i], NULL, WNOHANG) == 0)
+      {
+          if (get_system_time() - start > StopTimeout)
+          {
+              kill(Children[i], SIGKILL);
+              waitpid(Children[i], NULL, 0);
+              break;
+          }
+          usleep(PollInterval * 1000);
+      }
+  }
+  Children.clear();
+}
+
+
+/// cluster_start_search() is called by the search once the root moves are
+/// known. On the coordinator the root moves are dealt round robin among us
+/// and the idle workers, which get the root position and their share, to
+/// search up to maxDepth, or until stopped when it is 0. When there are too
+/// few moves every process searches them all. Returns true when the root is
+/// split, ownMoves[] is then filled with the share of the coordinator.
+
+bool cluster_start_search(const Position& pos, const Move rootMoves[], int maxDepth, Move ownMoves[]) {
+
+  if (!ClusterEnabled)
+      return false;
+
+  lock_grab(&OutboxLock);
+  OutboxCount = 0;
+  lock_release(&OutboxLock);
+
+  OwnResults.clear();
+  Searching = true;
+
+  if (IsWorker)
+      return false;
+
+  lock_grab(&PeersLock);
+
+  std::vector<size_t> idle;
+  int n = 0, k = 0;
+  char buf[MAX_MOVE_STRING];
+
+  // Results of a worker still busy with the previous search are stale
+  for (size_t i = 0; i < Peers.size(); i++)
+  {
+      Peers[i].results.clear();
+      Peers[i].pending = Result();
+
+      if (!Peers[i].busy)
+          idle.push_back(i);
+  }
+
+  while (rootMoves[n] != MOVE_NONE)
+      n++;
+
+  int shares = int(idle.size()) + 1;
+  bool split = (idle.size() && n >= shares);
+
+  for (size_t w = 0; w < idle.size(); w++)
+  {
+      Connection& c = Peers[idle[w]];
+      std::stringstream s;
+
+      s << "setoption name UCI_Chess960 value " << (pos.is_chess960() ? "true" : "false")
+        << "\nposition fen " << pos.to_fen()
+        << "\ngo ";
+
+      if (maxDepth)
+          s << "depth " << maxDepth;
+      else
+          s << "infinite";
+
+      s << " searchmoves";
+
+      for (int i = split ? 1 + int(w) : 0; i < n; i += split ? shares : 1)
+          s << " " << move_to_uci(rootMoves[i], pos.is_chess960(), buf);
+
+      s << "\n";
+      c.out += s.str();
+      c.busy = true;
+      c.stopped = false;
+      c.nodes = 0;
+  }
+
+  lock_release(&PeersLock);
+
+  for (int i = 0; split && i < n; i += shares)
+      ownMoves[k++] = rootMoves[i];
+
+  ownMoves[k] = MOVE_NONE;
+  return split;
+}
+
+
+/// cluster_iteration() records a completed iteration of the coordinator,
+/// to be compared with the ones of the workers at the end of the search.
+
+void cluster_iteration(int depth, Value v, const Move pv[], bool chess960) {
+
+  if (!ClusterEnabled || IsWorker)
+      return;
+
+  char buf[MAX_MOVE_STRING];
+  Result r;
+
+  r.depth = depth;
+  r.value = v;
+  r.best = move_to_uci(pv[0], chess960, buf);
+  r.ponder = pv[0] != MOVE_NONE && pv[1] != MOVE_NONE ? move_to_uci(pv[1], chess960, buf) : "";
+
+  if (int(OwnResults.size()) <= depth)
+      OwnResults.resize(depth + 1);
+
+  OwnResults[depth] = r;
+}
+
+
+/// cluster_stop_search() is called when the search is finished. When it has
+/// reached the depth limit ('finished') the coordinator waits for the
+/// workers to reach it too, unless some input arrives, otherwise it stops
+/// them and waits a little for their last results. Then, if the share of a
+/// worker has a better score than ours at the deepest depth completed by
+/// all the shares, the best and ponder moves are replaced with the deepest
+/// ones of that worker.
+
+void cluster_stop_search(Position& pos, bool finished, Move* bestMove, Move* ponderMove) {
+
+  if (!ClusterEnabled)
+      return;
+
+  Searching = false;
+
+  if (IsWorker)
+      return;
+
+  int start = get_system_time();
+  bool waiting = true;
+
+  while (waiting)
+  {
+      // Input is left to the UCI loop, it only ends the wait
+      if (finished && input_available())
+          finished = false;
+
+      waiting = false;
+      lock_grab(&PeersLock);
+
+      for (size_t i = 0; i < Peers.size(); i++)
+          if (Peers[i].busy)
+          {
+              if (!finished && !Peers[i].stopped)
+              {
+                  Peers[i].out += "stop\n";
+                  Peers[i].stopped = true;
+                  start = get_system_time();
+              }
+              waiting = true;
+          }
+
+      lock_release(&PeersLock);
+
+      if (waiting && !finished && get_system_time() - start > StopTimeout)
+          break;
+
+      if (waiting)
+          usleep(PollInterval * 1000);
+  }
+
+  lock_grab(&PeersLock);
+
+  int64_t nodes = 0;
+  int workers = 0, depth = deepest_result(OwnResults, PLY_MAX), winner = -1;
+
+  for (size_t i = 0; i < Peers.size(); i++)
+      if (!Peers[i].results.empty())
+      {
+          nodes += Peers[i].nodes;
+          workers++;
+          depth = Min(depth, deepest_result(Peers[i].results, PLY_MAX));
+      }
+
+  Value bestValue = depth > 0 ? OwnResults[deepest_result(OwnResults, depth)].value : -VALUE_INFINITE;
+
+  for (size_t i = 0; depth > 0 && i < Peers.size(); i++)
+      if (!Peers[i].results.empty())
+      {
+          const Result& r = Peers[i].results[deepest_result(Peers[i].results, depth)];
+
+          if (!r.best.empty() && r.value > bestValue)
+          {
+              bestValue = r.value;
+              winner = int(i);
+          }
+      }
+
+  Result best;
+
+  if (winner >= 0)
+      best = Peers[winner].results.back();
+
+  lock_release(&PeersLock);
+
+  std::cout << "info string Cluster workers " << workers
+            << " nodes " << nodes << std::endl;
+
+  if (winner < 0)
+      return;
+
+  Move m = move_from_uci(pos, best.best);
+
+  if (m == MOVE_NONE)
+      return;
+
+  StateInfo st;
+  *bestMove = m;
+  pos.do_move(m, st);
+  *ponderMove = best.ponder.empty() ? MOVE_NONE : move_from_uci(pos, best.ponder);
+  pos.undo_move(m);
+
+  std::cout << best.line
+            << "\ninfo string Cluster best move from worker " << winner + 1
+            << " at depth " << depth << std::endl;
+}
+
+
+/// cluster_share() queues a transposition table entry to be sent to the
+/// other processes. When the outbox is full the entry is simply dropped.
+
+void cluster_share(Key posKey, Value v, ValueType t, Depth d, Move m, Value statV, Value statM) {
+
+  if (!Searching)
+      return;
+
+  lock_grab(&OutboxLock);
+
+  if (OutboxCount < OutboxSize)
+  {
+      SharedEntry& e = Outbox[OutboxCount++];
+      e.key = posKey;
+      e.value = v;
+      e.type = t;
+      e.depth = d;
+      e.move = m;
+      e.staticValue = statV;
+      e.staticMargin = statM;
+  }
+
+  lock_release(&OutboxLock);
+}
+
+
+namespace {
+
+  // start_network_thread() launches the thread serving all the connections
+
+  void start_network_thread() {
+
+    pthread_t pthreadID;
+
+    lock_init(&OutboxLock);
+    lock_init(&PeersLock);
+
+    // A peer closing the link must not kill us when we write to it
+    signal(SIGPIPE, SIG_IGN);
+
+    ClusterEnabled = true;
+
+    if (pthread_create(&pthreadID, NULL, network_loop, NULL) != 0)
+    {
+        std::cerr << "Failed to create cluster network thread" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(pthreadID);
+  }
+
+
+  // network_loop() is the network thread main loop. It waits for incoming
+  // data or for room to send pending output, accepts new workers, reads and
+  // writes what can be without blocking. When a worker loses the link with
+  // its coordinator its UCI loop is told to quit.
+
+  void* network_loop(void*) {
+
+    char buf[4096];
+    fd_set readFds, writeFds;
+    struct timeval timeout;
+    int maxFd, n;
+
+    while (true)
+    {
+        std::stringstream messages;
+
+        FD_ZERO(&readFds);
+        FD_ZERO(&writeFds);
+        maxFd = Max(ListenFd, StdoutPipe);
+
+        if (ListenFd >= 0)
+            FD_SET(ListenFd, &readFds);
+
+        if (StdoutPipe >= 0)
+            FD_SET(StdoutPipe, &readFds);
+
+        lock_grab(&PeersLock);
+
+        if (!StdinOut.empty())
+        {
+            FD_SET(StdinPipe, &writeFds);
+            maxFd = Max(maxFd, StdinPipe);
+        }
+
+        for (size_t i = 0; i < Peers.size(); i++)
+        {
+            FD_SET(Peers[i].fd, &readFds);
+
+            if (!Peers[i].out.empty())
+                FD_SET(Peers[i].fd, &writeFds);
+
+            maxFd = Max(maxFd, Peers[i].fd);
+        }
+
+        lock_release(&PeersLock);
+
+        timeout.tv_sec = 0;
+        timeout.tv_usec = PollInterval * 1000;
+        select(maxFd + 1, &readFds, &writeFds, NULL, &timeout);
+
+        lock_grab(&PeersLock);
+
+        if (ListenFd >= 0 && FD_ISSET(ListenFd, &readFds))
+        {
+            int fd = accept(ListenFd, NULL, NULL);
+
+            if (fd >= 0)
+            {
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                set_non_blocking(fd);
+                set_no_delay(fd);
+                Connection c = { fd, "", "", false, false, 0, std::vector<Result>(), Result() };
+                Peers.push_back(c);
+                messages << "info string Cluster worker " << Peers.size() << " connected\n";
+            }
+        }
+
+        // Worker UCI output is forwarded as is to the coordinator, by full
+        // lines so that shared entries cannot be inserted in the middle.
+        if (StdoutPipe >= 0 && FD_ISSET(StdoutPipe, &readFds) && (n = read(StdoutPipe, buf, sizeof(buf))) > 0)
+        {
+            size_t eol;
+
+            StdoutIn.append(buf, n);
+
+            if ((eol = StdoutIn.rfind('\n')) != string::npos)
+            {
+                if (!Peers.empty())
+                    Peers[0].out.append(StdoutIn, 0, eol + 1);
+
+                StdoutIn.erase(0, eol + 1);
+            }
+        }
+
+        for (size_t i = 0; i < Peers.size(); i++)
+        {
+            if (!FD_ISSET(Peers[i].fd, &readFds))
+                continue;
+
+            if ((n = recv(Peers[i].fd, buf, sizeof(buf), 0)) <= 0)
+            {
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                    continue;
+
+                FD_CLR(Peers[i].fd, &writeFds);
+                close(Peers[i].fd);
+                Peers.erase(Peers.begin() + i--);
+
+                if (IsWorker)
+                    StdinOut += "quit\n";
+                else
+                    messages << "info string Cluster worker disconnected\n";
+                continue;
+            }
+
+            Peers[i].in.append(buf, n);
+
+            size_t eol;
+            while ((eol = Peers[i].in.find('\n')) != string::npos)
+            {
+                string line = Peers[i].in.substr(0, eol);
+                Peers[i].in.erase(0, eol + 1);
+                handle_line(i, line);
+            }
+        }
+
+        flush_outbox();
+
+        for (size_t i = 0; i < Peers.size(); i++)
+            if (FD_ISSET(Peers[i].fd, &writeFds))
+                send_some(Peers[i].fd, Peers[i].out);
+
+        if (StdinPipe >= 0 && FD_ISSET(StdinPipe, &writeFds))
+            send_some(StdinPipe, StdinOut);
+
+        lock_release(&PeersLock);
+
+        if (!messages.str().empty())
+            std::cout << messages.str() << std::flush;
+    }
+    return NULL;
+  }
+
+
+  // handle_line() processes a line received from a peer. Transposition table
+  // entries are checked and stored while searching, and relayed to the other
+  // workers by the coordinator. Anything else is an UCI command for a worker,
+  // or a line of worker output for the coordinator.
+
+  void handle_line(size_t idx, const string& line) {
+
+    if (line.compare(0, 3, "tt ") == 0)
+    {
+        if (!Searching)
+            return;
+
+        std::istringstream is(line.substr(3));
+        Key key;
+        int v, t, d, m, sv, sm;
+
+        if (   !(is >> std::hex >> key >> std::dec >> v >> t >> d >> m >> sv >> sm)
+            || !entry_is_ok(Value(v), t, Depth(d), Move(m), Value(sv), Value(sm)))
+            return;
+
+        TT.store(key, Value(v), ValueType(t), Depth(d), Move(m), Value(sv), Value(sm));
+
+        for (size_t i = 0; !IsWorker && i < Peers.size(); i++)
+            if (i != idx && Peers[i].busy && Peers[i].out.size() < MaxPendingOutput)
+                Peers[i].out += line + "\n";
+    }
+    else if (IsWorker)
+        StdinOut += line + "\n";
+
+    else if (line.compare(0, 8, "bestmove") == 0)
+    {
+        if (!Peers[idx].stopped)
+            commit_result(Peers[idx]);
+
+        Peers[idx].busy = false;
+    }
+
+    else
+    {
+        size_t pos = line.find(" nodes ");
+
+        if (pos != string::npos)
+            std::istringstream(line.substr(pos + 7)) >> Peers[idx].nodes;
+
+        if (line.compare(0, 11, "info depth ") == 0 && !Peers[idx].stopped)
+            read_result(Peers[idx], line);
+    }
+  }
+
+
+  // read_result() reads an info line of a worker. The first PV line of an
+  // iteration becomes the pending result, the line of a deeper iteration
+  // means that the pending one is complete.
+
+  void read_result(Connection& c, const string& line) {
+
+    std::istringstream is(line);
+    string token, type;
+    int multiPV = 1, v = 0;
+    Result r;
+
+    r.line = line;
+
+    while (is >> token)
+        if (token == "depth")
+            is >> r.depth;
+        else if (token == "multipv")
+            is >> multiPV;
+        else if (token == "score")
+            is >> type >> v;
+        else if (token == "pv")
+        {
+            is >> r.best >> r.ponder;
+            break;
+        }
+
+    if (r.depth <= 0 || r.depth > PLY_MAX)
+        return;
+
+    if (r.depth > c.pending.depth)
+        commit_result(c);
+
+    if (multiPV != 1 || type.empty() || r.best.empty())
+        return;
+
+    r.value = value_from_uci(type, v);
+    c.pending = r;
+  }
+
+
+  // commit_result() moves the pending result of a worker, if any, to its
+  // completed iterations.
+
+  void commit_result(Connection& c) {
+
+    if (c.pending.best.empty())
+        return;
+
+    if (int(c.results.size()) <= c.pending.depth)
+        c.results.resize(c.pending.depth + 1);
+
+    c.results[c.pending.depth] = c.pending;
+    c.pending = Result();
+  }
+
+
+  // value_from_uci() is the inverse of value_to_uci() in search.cpp
+
+  Value value_from_uci(const string& type, int v) {
+
+    if (type == "mate")
+        return v > 0 ? Value(VALUE_MATE - 2 * v + 1) : Value(-VALUE_MATE - 2 * v);
+
+    return Value(v * int(PawnValueMidgame) / 100);
+  }
+
+
+  // deepest_result() returns the depth of the deepest result not deeper than
+  // maxDepth, 0 if none. Results start at depth 1 and have no holes, so there
+  // is one at the returned depth whenever maxDepth is not below the first.
+
+  int deepest_result(const std::vector<Result>& results, int maxDepth) {
+
+    for (int d = Min(maxDepth, int(results.size()) - 1); d > 0; d--)
+        if (!results[d].best.empty())
+            return d;
+
+    return 0;
+  }
+
+
+  // entry_is_ok() checks that the fields of an entry received from another
+  // process are in the ranges the search stores, so that a bad line cannot
+  // put garbage in the transposition table. Moves read from the table are
+  // validated by the search anyway, as after a key collision.
+
+  bool entry_is_ok(Value v, int t, Depth d, Move m, Value statV, Value statM) {
+
+    return   abs(v) < VALUE_INFINITE
+          && t >= VALUE_TYPE_UPPER && t <= VALUE_TYPE_EXACT
+          && d >= ClusterShareDepth && d <= PLY_MAX * ONE_PLY
+          && m >= 0 && m <= 0xFFFF && (m == MOVE_NONE || move_is_ok(m))
+          && abs(statV) <= VALUE_NONE
+          && abs(statM) <= VALUE_NONE;
+  }
+
+
+  // flush_outbox() moves the queued entries to the output of all the peers
+
+  void flush_outbox() {
+
+    std::stringstream s;
+
+    lock_grab(&OutboxLock);
+
+    for (int i = 0; i < OutboxCount; i++)
+    {
+        const SharedEntry& e = Outbox[i];
+
+        s << "tt " << std::hex << e.key << std::dec
+          << " " << int(e.value) << " " << int(e.type) << " " << int(e.depth)
+          << " " << int(e.move)  << " " << int(e.staticValue)
+          << " " << int(e.staticMargin) << "\n";
+    }
+    OutboxCount = 0;
+
+    lock_release(&OutboxLock);
+
+    if (s.str().empty())
+        return;
+
+    for (size_t i = 0; i < Peers.size(); i++)
+        if ((IsWorker || Peers[i].busy) && Peers[i].out.size() < MaxPendingOutput)
+            Peers[i].out += s.str();
+  }
+
+
+  // send_some() writes to a non-blocking descriptor as much of the string as
+  // it can take and removes it from the string. A broken link is detected
+  // when reading from it.
+
+  void send_some(int fd, string& s) {
+
+    ssize_t n = write(fd, s.data(), s.size());
+
+    if (n > 0)
+        s.erase(0, n);
+  }
+
+
+  // set_non_blocking() makes reads and writes on the descriptor return at
+  // once instead of waiting.
+
+  void set_non_blocking(int fd) {
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+
+
+  // set_no_delay() disables Nagle's algorithm, messages are small and
+  // latency matters more than bandwidth.
+
+  void set_no_delay(int fd) {
+
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  }
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(CLUSTER_H_INCLUDED)
+#define CLUSTER_H_INCLUDED
+
+#include <string>
+
+#include "move.h"
+#include "types.h"
+
+class Position;
+
+/// A cluster spreads one search over several engine processes, possibly on
+/// different hosts, linked by TCP. The coordinator is the normal UCI engine
+/// with "Cluster Port" option set, workers are started with the "worker"
+/// command line argument and connect to it. At each search the root moves
+/// are dealt among the coordinator and its idle workers, which search their
+/// share with "go depth" or "go infinite" and "searchmoves", while all the
+/// processes exchange the deep transposition table entries they store. At
+/// the end the best of the shares, compared at the deepest depth completed
+/// by all of them, gives the move played.
+
+/// Only entries at least this deep are sent to the other processes
+const Depth ClusterShareDepth = Depth(6 * ONE_PLY);
+
+extern bool ClusterEnabled;
+
+extern bool cluster_listen(const std::string& bindAddress, int port);
+extern bool cluster_connect(const std::string& host, int port);
+extern int cluster_spawn_workers(int count);
+extern void cluster_shutdown();
+extern bool cluster_start_search(const Position& pos, const Move rootMoves[], int maxDepth, Move ownMoves[]);
+extern void cluster_iteration(int depth, Value v, const Move pv[], bool chess960);
+extern void cluster_stop_search(Position& pos, bool finished, Move* bestMove, Move* ponderMove);
+extern void cluster_share(Key posKey, Value v, ValueType t, Depth d, Move m, Value statV, Value statM);
+
+#endif // !defined(CLUSTER_H_INCLUDED)
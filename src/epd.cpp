@@ -0,0 +1,275 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "move.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "ucioption.h"
+
+using namespace std;
+
+namespace {
+
+  // An EPD record is a position followed by operations, we are interested
+  // in "bm" (best moves), "am" (moves to avoid) and "id".
+
+  struct EpdRecord {
+    string fen, id;
+    vector<Move> bestMoves, avoidMoves;
+  };
+
+  // Solving state of the position being searched, updated by on_iteration()
+  struct SolveInfo {
+    bool solved;
+    int depth, time;
+    int64_t nodes;
+  };
+
+  const EpdRecord* Current;
+  SolveInfo Solve;
+
+  // strip_san() removes check, mate and annotation symbols from a SAN move
+  string strip_san(const string& san) {
+
+    string s = san;
+
+    while (!s.empty() && string("+#!?").find(s[s.size() - 1]) != string::npos)
+        s.erase(s.size() - 1);
+
+    return s;
+  }
+
+  // move_from_epd() converts a move written in SAN, or in coordinate notation,
+  // to a legal move in the given position. Returns MOVE_NONE if there is none.
+  Move move_from_epd(Position& pos, const string& str) {
+
+    MoveStack mlist[MAX_MOVES];
+    MoveStack* last = generate<MV_LEGAL>(pos, mlist);
+    string s = strip_san(str);
+
+    for (MoveStack* cur = mlist; cur != last; cur++)
+        if (   strip_san(move_to_san(pos, cur->move)) == s
+            || move_to_uci(cur->move, pos.is_chess960()) == s)
+            return cur->move;
+
+    return MOVE_NONE;
+  }
+
+  // parse_epd() reads an EPD line. The first four fields are the position,
+  // then operations terminated by ';'. Returns false if the line has no bm
+  // or am operation, or if any of their moves is not a legal move, so that
+  // a record is never tested against only part of its moves.
+  bool parse_epd(const string& line, EpdRecord& r) {
+
+    istringstream is(line);
+    string token, op;
+
+    for (int i = 0; i < 4 && is >> token; i++)
+        r.fen += (i ? " " : "") + token;
+
+    Position pos(r.fen, false, 0);
+
+    while (getline(is, op, ';'))
+    {
+        istringstream ops(op);
+        string opcode;
+
+        if (!(ops >> opcode))
+            continue;
+
+        if (opcode == "id")
+        {
+            getline(ops >> ws, r.id);
+            r.id.erase(remove(r.id.begin(), r.id.end(), '"'), r.id.end());
+        }
+        else if (opcode == "bm" || opcode == "am")
+            while (ops >> token)
+            {
+                Move m = move_from_epd(pos, token);
+
+                if (m == MOVE_NONE)
+                    return false;
+
+                (opcode == "bm" ? r.bestMoves : r.avoidMoves).push_back(m);
+            }
+    }
+    return !r.bestMoves.empty() || !r.avoidMoves.empty();
+  }
+
+  // on_iteration() is the search iteration hook. The position counts as
+  // solved from the first iteration whose best move is right and is followed
+  // only by iterations with a right move.
+  void on_iteration(int depth, Move bestMove, Value, int64_t nodes, int time) {
+
+    bool ok =   (Current->bestMoves.empty() || count(Current->bestMoves.begin(), Current->bestMoves.end(), bestMove))
+             && !count(Current->avoidMoves.begin(), Current->avoidMoves.end(), bestMove);
+
+    if (!ok)
+        Solve.solved = false;
+
+    else if (!Solve.solved)
+    {
+        Solve.solved = true;
+        Solve.depth = depth;
+        Solve.time = time;
+        Solve.nodes = nodes;
+    }
+  }
+}
+
+
+/// epd_test() runs a test suite of positions in EPD format and reports how
+/// many of them are solved and how fast. The parameters are the file name,
+/// the limit value for each position (default 5), the type of the limit:
+/// time in secs (default), nodes or depth, the number of threads and the
+/// transposition table size. Positions are searched one after the other
+/// with all the threads. A position is solved when the best move, at the end
+/// of an iteration, satisfies the bm/am operations from then on, the solve
+/// time and nodes are taken at that iteration.
+
+void epd_test(int argc, char* argv[]) {
+
+  vector<EpdRecord> suite;
+  vector<SolveInfo> results;
+  vector<int> skipped;
+  SearchLimits limits;
+  string line;
+
+  string fileName = argv[2];
+  int limit       = argc > 3 ? atoi(argv[3]) : 5;
+  string valType  = argc > 4 ? argv[4] : "time";
+  string threads  = argc > 5 ? argv[5] : "1";
+  string ttSize   = argc > 6 ? argv[6] : "128";
+
+  ifstream f(fileName.c_str());
+
+  if (!f.is_open())
+  {
+      cerr << "Unable to open EPD file " << fileName << endl;
+      exit(EXIT_FAILURE);
+  }
+
+  for (int lineNumber = 1; getline(f, line); lineNumber++)
+  {
+      EpdRecord r;
+
+      if (line.find_first_not_of(" \t\r") == string::npos)
+          continue;
+
+      if (parse_epd(line, r))
+          suite.push_back(r);
+      else
+          skipped.push_back(lineNumber);
+  }
+
+  // Records left out would silently change the score of the suite
+  if (!skipped.empty())
+  {
+      cerr << "Skipped " << skipped.size() << " records without bm/am or with"
+           << " moves that are not legal, lines:";
+
+      for (size_t i = 0; i < skipped.size(); i++)
+          cerr << " " << skipped[i];
+
+      cerr << endl << endl;
+  }
+
+  Options["Hash"].set_value(ttSize);
+  Options["Threads"].set_value(threads);
+  Options["OwnBook"].set_value("false");
+
+  if (valType == "nodes")
+      limits.maxNodes = limit;
+  else if (valType == "depth")
+      limits.maxDepth = limit;
+  else
+      limits.maxTime = 1000 * limit;
+
+  SearchIterationHook = on_iteration;
+
+  for (size_t i = 0; i < suite.size(); i++)
+  {
+      Move moves[] = { MOVE_NONE };
+      Position pos(suite[i].fen, false, 0);
+
+      Current = &suite[i];
+      Solve.solved = false;
+
+      Options["Clear Hash"].set_value("true");
+
+      if (!think(pos, limits, moves))
+          break;
+
+      results.push_back(Solve);
+
+      cerr << "\nEPD position " << i + 1 << '/' << suite.size()
+           << (suite[i].id.empty() ? "" : " (" + suite[i].id + ")")
+           << (Solve.solved ? " solved" : " not solved");
+
+      if (Solve.solved)
+          cerr << " at depth " << Solve.depth << ", time " << Solve.time
+               << " ms, nodes " << Solve.nodes;
+
+      cerr << endl;
+  }
+
+  SearchIterationHook = NULL;
+
+  // Summary, then the cumulative distribution of the solutions over ten
+  // steps of the limit, or over each ply when limited by depth.
+  int solved = 0, totalTime = 0;
+  int64_t totalNodes = 0;
+
+  for (size_t i = 0; i < results.size(); i++)
+      if (results[i].solved)
+      {
+          solved++;
+          totalTime += results[i].time;
+          totalNodes += results[i].nodes;
+      }
+
+  cerr << "\n==============================="
+       << "\nPositions solved      : " << solved << '/' << results.size()
+       << "\nTotal solve time (ms) : " << totalTime
+       << "\nAverage solve nodes   : " << (solved ? totalNodes / solved : 0)
+       << "\n\nSolutions found within (" << (valType == "nodes" || valType == "depth" ? valType : "ms") << "):" << endl;
+
+  int steps = (valType == "depth" ? limit : 10);
+
+  for (int s = 1; s <= steps; s++)
+  {
+      int64_t bound = valType == "depth" ? s : int64_t(limits.maxTime + limits.maxNodes) * s / steps;
+      int n = 0;
+
+      for (size_t i = 0; i < results.size(); i++)
+          if (   results[i].solved
+              && (valType == "depth" ? results[i].depth : valType == "nodes" ? results[i].nodes : results[i].time) <= bound)
+              n++;
+
+      cerr << "  " << bound << "\t" << n << " (" << (results.empty() ? 0 : 100 * n / int(results.size())) << "%)" << endl;
+  }
+  cerr << endl;
+}
@@ -25,6 +25,7 @@
 #include "bitcount.h"
 #include "evaluate.h"
 #include "material.h"
+#include "nnue.h"
 #include "pawns.h"
 #include "thread.h"
 #include "ucioption.h"
@@ -90,7 +91,7 @@ namespace {
   Score Weights[6];
 
   typedef Value V;
-  #define S(mg, eg) make_score(mg, eg)
+  #define S(mg, eg) { mg, eg }
 
   // Internal evaluation weights. These are applied on top of the evaluation
   // weights read from UCI parameters. The purpose is to be able to change
@@ -232,6 +233,15 @@ namespace {
   Score TracedScores[2][16];
   std::stringstream TraceStream;
 
+  // Evaluation backend selection, set by "Use NN Eval" UCI option when
+  // the network file named by "NN Weights File" is successfully loaded.
+  bool UseNNEval;
+  std::string NNFileName;
+
+  // Slider attacks are computed with Kogge-Stone fills instead of magic
+  // lookups when "Use Kogge-Stone Attacks" UCI option is set.
+  bool UseKoggeStone;
+
   enum TracedType {
       PST = 8, IMBALANCE = 9, MOBILITY = 10, THREAT = 11,
       PASSED = 12, UNSTOPPABLE = 13, SPACE = 14, TOTAL = 15
@@ -266,7 +276,6 @@ namespace {
   bool stalemate(const Position& pos, EvalInfo& ei);
   bool possible_stalemate(const Position& pos, EvalInfo& ei, Color c);
 
-  inline Score apply_weight(Score v, Score weight);
   Value scale_by_game_phase(const Score& v, Phase ph, ScaleFactor sf);
   Score weight_option(const std::string& mgOpt, const std::string& egOpt, Score internalWeight);
   void init_safety();
@@ -280,6 +289,12 @@ namespace {
 /// between them based on the remaining material.
 Value evaluate(const Position& pos, Value& margin) {
 
+  if (UseNNEval)
+  {
+      margin = VALUE_ZERO;
+      return nnue_evaluate(pos);
+  }
+
   return CpuHasPOPCNT ? do_evaluate<true, false>(pos, margin)
                       : do_evaluate<false, false>(pos, margin);
 }
@@ -471,6 +486,24 @@ void read_evaluation_uci_options(Color us) {
       Weights[kingDangerUs] = Weights[kingDangerThem] = (Weights[kingDangerUs] + Weights[kingDangerThem]) / 2;
 
   init_safety();
+
+  UseKoggeStone = Options["Use Kogge-Stone Attacks"].value<bool>();
+
+  // Select the evaluation backend, (re)loading the network if file changed
+  UseNNEval = false;
+
+  if (Options["Use NN Eval"].value<bool>())
+  {
+      std::string fileName = Options["NN Weights File"].value<std::string>();
+
+      if (fileName != NNFileName)
+      {
+          NNFileName = fileName;
+          if (!nnue_load(fileName))
+              std::cout << "info string Unable to load network from " << fileName << std::endl;
+      }
+      UseNNEval = nnue_is_loaded();
+  }
 }
 
 
@@ -541,16 +574,27 @@ namespace {
     const BitCountType Full  = HasPopCnt ? CNT_POPCNT : CpuIs64Bit ? CNT64 : CNT32;
     const BitCountType Max15 = HasPopCnt ? CNT_POPCNT : CpuIs64Bit ? CNT64_MAX15 : CNT32_MAX15;
     const Color Them = (Us == WHITE ? BLACK : WHITE);
-    const Square* ptr = pos.piece_list_begin(Us, Piece);
+    const uint8_t* ptr = pos.piece_list_begin(Us, Piece);
 
     ei.attackedBy[Us][Piece] = EmptyBoardBB;
 
-    while ((s = *ptr++) != SQ_NONE)
+    while ((s = Square(*ptr++)) != SQ_NONE)
     {
 		assert(pos.piece_on(s));
 
         // Find attacked squares, including x-ray attacks for bishops and rooks
-        if (Piece == KNIGHT || Piece == QUEEN)
+        if (Piece == KNIGHT)
+            b = pos.attacks_from<Piece>(s);
+        else if (UseKoggeStone)
+        {
+            if (Piece == BISHOP)
+                b = sliding_attacks_ks<BISHOP>(SetMaskBB[s], pos.occupied_squares() & ~pos.pieces(QUEEN, Us));
+            else if (Piece == ROOK)
+                b = sliding_attacks_ks<ROOK>(SetMaskBB[s], pos.occupied_squares() & ~pos.pieces(ROOK, QUEEN, Us));
+            else
+                b = sliding_attacks_ks<QUEEN>(SetMaskBB[s], pos.occupied_squares());
+        }
+        else if (Piece == QUEEN)
             b = pos.attacks_from<Piece>(s);
         else if (Piece == BISHOP)
             b = bishop_attacks_bb(s, pos.occupied_squares() & ~pos.pieces(QUEEN, Us));
@@ -747,7 +791,7 @@ namespace {
     const Square ksq = pos.king_square(Us);
 
     // King shelter
-	Score score = ei.pi->king_shelter<Us>(pos, ksq);
+	Score score = ei.pi->king_shelter<Us>(ksq);
 	
     // King safety. This is quite complicated, and is almost certainly far
     // from optimally tuned.
@@ -769,7 +813,7 @@ namespace {
         attackUnits =  Min(25, (ei.kingAttackersCount[Them] * ei.kingAttackersWeight[Them]) / 2)
                      + 3 * (ei.kingAdjacentZoneAttacksCount[Them] + count_1s<Max15>(undefended))
                      + InitKingDanger[relative_square(Us, ksq)]
-		             - mg_value(ei.pi->king_shelter<Us>(pos, ksq)) / 32;                   
+		             - mg_value(ei.pi->king_shelter<Us>(ksq)) / 32;                   
 
         // Analyse enemy's safe queen contact checks. First find undefended
         // squares around the king attacked by enemy queen...
@@ -1307,14 +1351,6 @@ namespace {
   }
 
 
-  // apply_weight() applies an evaluation weight to a value trying to prevent overflow
-
-  inline Score apply_weight(Score v, Score w) {
-    return make_score((int(mg_value(v)) * mg_value(w)) / 0x100,
-                      (int(eg_value(v)) * eg_value(w)) / 0x100);
-  }
-
-
   // scale_by_game_phase() interpolates between a middle game and an endgame score,
   // based on game phase. It also scales the return value by a ScaleFactor array.
 
@@ -21,11 +21,14 @@
 //#define USE_CALLGRIND
 
 #include <cstdio>
+#include <iomanip>
 #include <iostream>
 #include <string>
 
 #include "bitboard.h"
+#include "cluster.h"
 #include "evaluate.h"
+#include "misc.h"
 #include "position.h"
 #include "thread.h"
 #include "search.h"
@@ -38,24 +41,67 @@
 using namespace std;
 
 extern void execute_uci_command();
+extern void startup_handshake(int64_t* uciokTime, int64_t* bestmoveTime);
 extern void benchmark(int argc, char* argv[]);
+extern void batch_benchmark(int argc, char* argv[]);
+extern void cluster_benchmark(int argc, char* argv[]);
+extern void epd_test(int argc, char* argv[]);
 extern void init_kpk_bitbase();
 
+namespace {
+
+  // Startup profile, the time of each init stage and of the handshake with
+  // a GUI, in microseconds from the start of main().
+  const int MaxStartupStages = 8;
+
+  const char* StageNames[MaxStartupStages];
+  int64_t StageTimes[MaxStartupStages];
+  int64_t StartupTime, UciokTime, BestmoveTime;
+  int StageCount;
+
+  void end_stage(const char* name) {
+
+    StageNames[StageCount] = name;
+    StageTimes[StageCount++] = get_monotonic_time() - StartupTime;
+  }
+
+  // print_startup_profile() prints the time of each init stage and, when the
+  // handshake has been done, the time to "uciok" and to the first "bestmove".
+  void print_startup_profile(bool handshake) {
+
+    cerr << "\nStartup profile (ms)" << fixed << setprecision(3);
+
+    for (int i = 0; i < StageCount; i++)
+        cerr << "\n" << setw(24) << left << StageNames[i] << right << setw(10)
+             << (StageTimes[i] - (i ? StageTimes[i - 1] : 0)) / 1000.0;
+
+    cerr << "\n" << setw(24) << left << "Total init" << right << setw(10) << StageTimes[StageCount - 1] / 1000.0;
+
+    if (handshake)
+        cerr << "\n" << setw(24) << left << "Time to uciok" << right << setw(10) << (UciokTime - StartupTime) / 1000.0
+             << "\n" << setw(24) << left << "Time to first bestmove" << right << setw(10) << (BestmoveTime - StartupTime) / 1000.0;
+
+    cerr << endl << endl;
+  }
+}
+
 int main(int argc, char* argv[]) {
 
+  StartupTime = get_monotonic_time();
+
   // Disable IO buffering for C and C++ standard libraries
   setvbuf(stdin, NULL, _IONBF, 0);
   setvbuf(stdout, NULL, _IONBF, 0);
   cout.rdbuf()->pubsetbuf(NULL, 0);
   cin.rdbuf()->pubsetbuf(NULL, 0);
 
-  // Startup initializations
-  init_bitboards();
-  Position::init_zobrist();
-  Position::init_piece_square_tables();
-  init_kpk_bitbase();
-  init_search();
-  Threads.init();
+  // Startup initializations, each stage is timed for the startup profile
+  init_bitboards();                    end_stage("init_bitboards");
+  Position::init_zobrist();            end_stage("init_zobrist");
+  Position::init_piece_square_tables(); end_stage("init_piece_square_tables");
+  init_kpk_bitbase();                  end_stage("init_kpk_bitbase");
+  init_search();                       end_stage("init_search");
+  Threads.init();                      end_stage("Threads.init");
 
 #ifdef USE_CALLGRIND
   CALLGRIND_START_INSTRUMENTATION;
@@ -75,12 +121,48 @@ int main(int argc, char* argv[]) {
       
       execute_uci_command();
   }
-  else if (string(argv[1]) == "bench" && argc < 8)
+  else if (string(argv[1]) == "--startup-profile" && argc == 2)
+  {
+      startup_handshake(&UciokTime, &BestmoveTime);
+      print_startup_profile(true);
+  }
+  else if (string(argv[1]) == "bench" && argc < 15)
+  {
+      // The init stages are timed anyway, so that startup regressions show
+      // up in the bench output too. The handshake search is left out, not to
+      // change the searches of the benchmark and of the PGO build.
       benchmark(argc, argv);
+      print_startup_profile(false);
+  }
+  else if (string(argv[1]) == "batch" && argc < 7)
+      batch_benchmark(argc, argv);
+  else if (string(argv[1]) == "cluster" && argc < 7)
+      cluster_benchmark(argc, argv);
+  else if (string(argv[1]) == "epd" && argc > 2 && argc < 8)
+      epd_test(argc, argv);
+  else if (string(argv[1]) == "worker" && argc == 4)
+  {
+      // Serve as a cluster worker, receiving UCI commands from the coordinator
+      if (cluster_connect(argv[2], atoi(argv[3])))
+          execute_uci_command();
+  }
   else
       cout << "Usage: stockfish bench [hash size = 128] [threads = 1] "
-           << "[limit = 12] [fen positions file = default] "
-           << "[limited by depth, time, nodes or perft = depth]" << endl;
+           << "[limit = 12] [fen positions file, opening, middlegame, "
+           << "endgame, tactical or all = default] "
+           << "[limited by depth, time, nodes, perft, domove, pseudolegal or mate = depth] "
+           << "[network file to compare evaluations with = none] "
+           << "[runs = 1] [baseline results file = none] "
+           << "[shared pawn hash MB = 0] [adaptive split = false] "
+           << "[numa replicated tables = false] [results file = none]\n"
+           << "       stockfish batch [hash size = 128] [depth = 5] "
+           << "[searches in flight = 4] [fen positions file = default]\n"
+           << "       stockfish cluster [workers = 2] [depth = 12] [hash size = 128] "
+           << "[fen positions file = default]\n"
+           << "       stockfish epd <epd file> [limit = 5] [limited by time, nodes "
+           << "or depth = time] [threads = 1] [hash size = 128]\n"
+           << "       stockfish worker <coordinator host> <coordinator port>\n"
+           << "       stockfish --startup-profile" << endl;
 
   Threads.exit();
   return 0;
@@ -0,0 +1,350 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "mate.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "timeman.h"
+
+/// The mate solver answers "go mate N" without the general search. It is a
+/// depth-limited search where the attacker only plays checks and the
+/// defender all its evasions, so the trees are tiny compared to a full
+/// width search but only mates delivered with checks at every move are
+/// found. Results are exact distances in plies, never bounds, and are kept
+/// in a small hash table of its own so that the main TT is not touched.
+/// The input and the limits of the "go" command are polled while searching,
+/// as the main search does, so that a "stop", a "quit", the time or the
+/// nodes allowed are obeyed at once also for very long mates.
+
+namespace {
+
+  // Plies to mate when there is no mate within the given depth
+  const int NoMate = 127;
+
+  struct MateEntry {
+    Key key;
+    Move move;
+    int8_t depth, plies;
+  };
+
+  const int MateHashSize = 1 << 18;
+  const int NodesBetweenPolls = 30000;
+
+  MateEntry MateHash[MateHashSize];
+  int64_t Nodes, NextPoll, MaxNodes;
+  int StartTime, MaxTime;
+  MateCommand Command;
+  bool Polling, Pondering;
+
+  int attack(Position& pos, int depth, const Move searchMoves[] = NULL);
+  int defend(Position& pos, int depth);
+
+  // move_is_listed() tells whether the move is in the list terminated by MOVE_NONE
+  bool move_is_listed(Move m, const Move list[]) {
+
+    while (*list != MOVE_NONE && *list != m)
+        list++;
+
+    return *list == m;
+  }
+
+  // poll() reads a command sent while searching, only "stop", "quit" and
+  // "ponderhit" are expected here as in the main search, and then checks
+  // the time and the nodes, not limited while pondering.
+  void poll() {
+
+    std::string command;
+
+    // Nothing more is read once the search is aborted
+    if (Command >= MATE_LIMIT)
+        return;
+
+    NextPoll = Nodes + NodesBetweenPolls;
+
+    if (MaxNodes > Nodes)
+        NextPoll = Min(NextPoll, MaxNodes);
+
+    if (input_available())
+    {
+        if (!std::getline(std::cin, command) || command == "quit")
+            Command = MATE_QUIT;
+
+        else if (command == "stop")
+            Command = MATE_STOP;
+
+        else if (command == "ponderhit")
+        {
+            Pondering = false;
+            Command = MATE_PONDERHIT;
+        }
+    }
+
+    if (   Command < MATE_LIMIT
+        && !Pondering
+        && (   (MaxTime && get_system_time() - StartTime >= MaxTime)
+            || (MaxNodes && Nodes >= MaxNodes)))
+        Command = MATE_LIMIT;
+  }
+
+  inline MateEntry* probe(Key key) {
+
+    return MateHash + ((uint32_t)key & (MateHashSize - 1));
+  }
+
+  // attack() returns the plies of the shortest mate within depth plies for
+  // the side to move, giving check at every move, or NoMate if there is none.
+  // A mate once found is exact also for any other depth, while a failure
+  // holds only for depths not greater than the searched one. At the root
+  // the checks can be restricted to searchMoves, terminated by MOVE_NONE.
+  int attack(Position& pos, int depth, const Move searchMoves[]) {
+
+    MoveStack mlist[MAX_MOVES], evasions[MAX_MOVES];
+    MoveStack *cur, *last = mlist;
+    StateInfo st;
+    Key key = pos.get_key();
+    MateEntry* e = probe(key);
+    Move bestMove = MOVE_NONE;
+    int best = NoMate;
+
+    if (Polling && Nodes >= NextPoll)
+        poll();
+
+    // An aborted search returns without touching the hash table
+    if (Command >= MATE_LIMIT)
+        return NoMate;
+
+    if (e->key == key)
+    {
+        if (e->plies != NoMate)
+            return e->plies <= depth ? e->plies : NoMate;
+
+        if (e->depth >= depth)
+            return NoMate;
+    }
+
+    if (depth < 1)
+        return NoMate;
+
+    // Keep the legal checks only, scored by the number of replies left to
+    // the defender, so that the most forcing ones are tried first. A check
+    // without replies is a mate in one and ends the search.
+    CheckInfo ci(pos);
+    MoveStack* end = generate<MV_PSEUDO_LEGAL>(pos, mlist);
+
+    for (cur = mlist; cur != end; cur++)
+        if (   pos.move_gives_check(cur->move, ci)
+            && pos.pl_move_is_legal(cur->move)
+            && (!searchMoves || move_is_listed(cur->move, searchMoves)))
+        {
+            pos.do_move(cur->move, st, ci, true);
+            Nodes++;
+
+            int replies = (depth < 3 ? pos.has_legal_move() : int(generate<MV_LEGAL>(pos, evasions) - evasions));
+
+            pos.undo_move(cur->move);
+
+            if (!replies)
+            {
+                best = 1;
+                bestMove = cur->move;
+                break;
+            }
+            last->move = cur->move;
+            last->score = -replies;
+            last++;
+        }
+
+    if (best == NoMate && depth >= 3)
+    {
+        insertion_sort<MoveStack>(mlist, last);
+
+        // Only a mate shorter than the best found so far is of interest, and
+        // after the mates in one already excluded the shortest is a mate in two.
+        for (cur = mlist; cur != last && best > 3; cur++)
+        {
+            pos.do_move(cur->move, st, ci, true);
+            Nodes++;
+
+            int plies = defend(pos, Min(depth, best - 2) - 1);
+
+            pos.undo_move(cur->move);
+
+            if (plies != NoMate && plies + 1 < best)
+            {
+                best = plies + 1;
+                bestMove = cur->move;
+            }
+        }
+    }
+
+    if (Command >= MATE_LIMIT)
+        return NoMate;
+
+    e->key = key;
+    e->move = bestMove;
+    e->depth = int8_t(depth);
+    e->plies = int8_t(best);
+
+    return best;
+  }
+
+  // defend() returns the plies of the longest defence of the side to move,
+  // in check, against the mates found by attack() within depth plies, or
+  // NoMate as soon as one evasion escapes.
+  int defend(Position& pos, int depth) {
+
+    MoveStack mlist[MAX_MOVES];
+    StateInfo st;
+    int longest = 0;
+
+    assert(pos.in_check());
+
+    if (depth < 2)
+        return pos.has_legal_move() ? NoMate : 0;
+
+    CheckInfo ci(pos);
+    MoveStack* last = generate<MV_LEGAL>(pos, mlist);
+
+    for (MoveStack* cur = mlist; cur != last; cur++)
+    {
+        pos.do_move(cur->move, st, ci, pos.move_gives_check(cur->move, ci));
+        Nodes++;
+
+        int plies = attack(pos, depth - 1);
+
+        pos.undo_move(cur->move);
+
+        if (plies == NoMate)
+            return NoMate;
+
+        longest = Max(longest, plies + 1);
+    }
+    return longest;
+  }
+
+  // extract_pv() writes the line of a mate in the given plies, the attacker
+  // playing the shortest mate and the defender the longest defence, as
+  // found by searching again each node, mostly answered by the hash table.
+  // At the root the attacker is restricted to searchMoves as in the search.
+  void extract_pv(Position& pos, int plies, bool attacker, Move pv[],
+                  const Move searchMoves[] = NULL) {
+
+    MoveStack mlist[MAX_MOVES];
+    StateInfo st;
+    int next = 0;
+
+    *pv = MOVE_NONE;
+
+    if (plies <= 0)
+        return;
+
+    if (attacker)
+    {
+        next = attack(pos, plies, searchMoves) - 1;
+        *pv = probe(pos.get_key())->move;
+    }
+    else
+    {
+        CheckInfo ci(pos);
+        MoveStack* last = generate<MV_LEGAL>(pos, mlist);
+
+        for (MoveStack* cur = mlist; cur != last; cur++)
+        {
+            pos.do_move(cur->move, st, ci, pos.move_gives_check(cur->move, ci));
+            int p = attack(pos, plies - 1);
+            pos.undo_move(cur->move);
+
+            if (p >= next && p != NoMate)
+            {
+                next = p;
+                *pv = cur->move;
+            }
+        }
+    }
+
+    if (*pv == MOVE_NONE)
+        return;
+
+    pos.do_move(*pv, st);
+    extract_pv(pos, next, !attacker, pv + 1);
+    pos.undo_move(*pv);
+  }
+}
+
+
+/// mate_search() looks for the shortest mate in at most n moves for the side
+/// to move, checking at every move and starting with one of searchMoves, if
+/// any, within the depth, the nodes and the time of limits. Returns the
+/// number of moves of the mate found, 0 if none or if the search was
+/// aborted, writes its line in pv, terminated by MOVE_NONE, the number of
+/// nodes searched in nodes and the last command read in command.
+
+int mate_search(Position& pos, int n, const SearchLimits& limits, const Move searchMoves[],
+                Move pv[], int64_t* nodes, MateCommand* command) {
+
+  const Move* rootMoves = searchMoves[0] != MOVE_NONE ? searchMoves : NULL;
+  int plies = NoMate;
+
+  memset(MateHash, 0, sizeof(MateHash));
+  Nodes = 0;
+  MaxNodes = limits.maxNodes;
+  NextPoll = MaxNodes ? Min(MaxNodes, int64_t(NodesBetweenPolls)) : NodesBetweenPolls;
+  StartTime = get_system_time();
+  MaxTime = limits.maxTime;
+  Command = MATE_NO_COMMAND;
+  Polling = true;
+  Pondering = limits.ponder;
+  pv[0] = MOVE_NONE;
+
+  // With a clock the solver takes the time the search would take for a move
+  if (limits.useTimeManagement() && limits.time)
+  {
+      TimeManager tm;
+      tm.init(limits, pos.startpos_ply_counter());
+      MaxTime = tm.available_time();
+  }
+
+  n = Min(n, MaxMateMoves);
+
+  // Iterative deepening on the mate length, the hash table remembers the
+  // nodes already known to fail, so the shorter iterations are almost free.
+  for (int depth = 1;    depth < 2 * n
+                      && (!limits.maxDepth || depth <= limits.maxDepth)
+                      && plies == NoMate
+                      && Command < MATE_LIMIT; depth += 2)
+      plies = attack(pos, depth, rootMoves);
+
+  // The line of a mate found is always extracted whole, no input is read
+  Polling = false;
+
+  if (plies != NoMate)
+      extract_pv(pos, plies, true, pv, rootMoves);
+
+  *nodes = Nodes;
+  *command = Command;
+
+  return plies != NoMate ? (plies + 1) / 2 : 0;
+}
@@ -0,0 +1,42 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(MATE_H_INCLUDED)
+#define MATE_H_INCLUDED
+
+#include "move.h"
+#include "types.h"
+
+class Position;
+struct SearchLimits;
+
+/// Longest mate, in moves, mate_search() can look for
+const int MaxMateMoves = 50;
+
+/// The last command read by mate_search() while searching, or MATE_LIMIT
+/// when the time or the nodes of the search limits ran out. The limit, a
+/// "stop" or a "quit" aborts the search.
+enum MateCommand {
+  MATE_NO_COMMAND, MATE_PONDERHIT, MATE_LIMIT, MATE_STOP, MATE_QUIT
+};
+
+extern int mate_search(Position& pos, int n, const SearchLimits& limits, const Move searchMoves[],
+                       Move pv[], int64_t* nodes, MateCommand* command);
+
+#endif // !defined(MATE_H_INCLUDED)
@@ -20,11 +20,16 @@
 #if !defined(_MSC_VER)
 
 #  include <sys/time.h>
+#  include <time.h>
 #  include <sys/types.h>
 #  include <unistd.h>
 #  if defined(__hpux)
 #     include <sys/pstat.h>
 #  endif
+#  if defined(__linux__)
+#     include <sys/mman.h>
+#     include <sys/syscall.h>
+#  endif
 
 #else
 
@@ -40,6 +45,7 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -148,6 +154,25 @@ int get_system_time() {
 }
 
 
+/// get_monotonic_time() returns the time in microseconds from an unspecified
+/// starting point. Unlike get_system_time() it is not affected by changes of
+/// the system clock and it is precise enough to time short tasks.
+
+int64_t get_monotonic_time() {
+
+#if defined(_MSC_VER)
+  LARGE_INTEGER c, f;
+  QueryPerformanceCounter(&c);
+  QueryPerformanceFrequency(&f);
+  return int64_t(double(c.QuadPart) * 1000000 / double(f.QuadPart));
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return int64_t(t.tv_sec) * 1000000 + t.tv_nsec / 1000;
+#endif
+}
+
+
 /// cpu_count() tries to detect the number of CPU cores
 
 int cpu_count() {
@@ -268,3 +293,318 @@ void prefetch(char* addr) {
 }
 
 #endif
+
+
+/// alloc_interleaved() allocates a zeroed memory block whose pages are spread
+/// round robin over all the NUMA nodes, so that a table shared by threads
+/// running on different sockets does not live entirely in the memory of the
+/// node that allocated it. Where the OS does not support it, or the machine
+/// has a single node, it is a plain allocation. Returns NULL on failure, the
+/// block must be released with free_numa().
+
+void* alloc_interleaved(size_t size) {
+
+#if defined(__linux__)
+  void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (mem == MAP_FAILED)
+      return NULL;
+
+#  if defined(SYS_mbind)
+  // MPOL_INTERLEAVE over every node the kernel knows about. On a kernel
+  // without NUMA support the call fails and the default policy is kept.
+  const int MPOL_INTERLEAVE = 3;
+  unsigned long nodeMask = ~0UL;
+  syscall(SYS_mbind, mem, size, MPOL_INTERLEAVE, &nodeMask, sizeof(nodeMask) * 8, 0);
+#  endif
+  return mem;
+#elif defined(_MSC_VER)
+  return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  return calloc(size, 1);
+#endif
+}
+
+
+/// alloc_on_node() is like alloc_interleaved() but binds all the pages of the
+/// block to the memory of the given NUMA node.
+
+void* alloc_on_node(size_t size, int node) {
+
+#if defined(__linux__)
+  void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (mem == MAP_FAILED)
+      return NULL;
+
+#  if defined(SYS_mbind)
+  const int MPOL_BIND = 2;
+  unsigned long nodeMask = 1UL << node;
+  syscall(SYS_mbind, mem, size, MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8, 0);
+#  endif
+  return mem;
+#else
+  (void)node;
+  return alloc_interleaved(size);
+#endif
+}
+
+
+/// numa_node_count() returns the number of NUMA nodes of the machine, that
+/// is 1 when not known.
+
+int numa_node_count() {
+
+  int nodes = 1;
+
+#if defined(__linux__)
+  char path[64];
+
+  for ( ; nodes < 64; nodes++)
+  {
+      sprintf(path, "/sys/devices/system/node/node%d", nodes);
+      if (access(path, F_OK))
+          break;
+  }
+#endif
+  return nodes;
+}
+
+
+/// current_numa_node() returns the NUMA node of the CPU the calling thread
+/// is running on, 0 when not known.
+
+int current_numa_node() {
+
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu, node;
+
+  if (!syscall(SYS_getcpu, &cpu, &node, NULL))
+      return int(node);
+#endif
+  return 0;
+}
+
+
+/// free_numa() releases a block from alloc_interleaved() or alloc_on_node()
+
+void free_numa(void* mem, size_t size) {
+
+  if (!mem)
+      return;
+
+#if defined(__linux__)
+  munmap(mem, size);
+#elif defined(_MSC_VER)
+  VirtualFree(mem, 0, MEM_RELEASE);
+  (void)size; // Only needed by munmap()
+#else
+  free(mem);
+  (void)size;
+#endif
+}
+
+
+/// Allocation tracking, enabled at compile time with TRACK_ALLOCATIONS
+/// (make alloctrack=yes). Global operator new, malloc(), calloc() and
+/// realloc() are replaced by versions that, between alloc_tracking(true)
+/// and alloc_tracking(false), count the calls per thread and per call site,
+/// the innermost caller inside the engine code. The C functions forward to
+/// the glibc allocator, so this needs glibc. Counting is lock free and never
+/// allocates. alloc_print_report() prints and resets the counters, call
+/// sites are printed as symbols when available or as offsets in the
+/// executable, to be fed to addr2line.
+#if defined(TRACK_ALLOCATIONS)
+
+#include <cstdlib>
+#include <execinfo.h>
+#include <new>
+
+extern char __executable_start, etext; // Provided by the GNU linker
+
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* p, size_t size);
+}
+
+namespace {
+
+  const int AllocMaxThreads = 64;
+  const int AllocMaxSites = 1024;
+
+  volatile bool AllocTracking;
+  volatile int AllocThreadCount;
+  volatile long AllocPerThread[AllocMaxThreads];
+  void* volatile AllocSites[AllocMaxSites];
+  volatile long AllocSiteCount[AllocMaxSites];
+
+  __thread int AllocThreadIdx = -1;
+  __thread bool AllocInTracker;
+
+  // call_site() returns the innermost return address inside the executable,
+  // skipping the frames of the tracker, up to the return address of the
+  // replaced function, and the ones of the shared C and C++ libraries.
+  void* call_site(void* caller) {
+
+    void* frames[16];
+    int n = backtrace(frames, 16), i = 0;
+
+    while (i < n && frames[i] != caller)
+        i++;
+
+    for ( ; i < n; i++)
+        if ((char*)frames[i] >= &__executable_start && (char*)frames[i] < &etext)
+            return frames[i];
+
+    return (void*)1; // Unknown
+  }
+
+  void track_allocation(void* caller) {
+
+    if (!AllocTracking || AllocInTracker)
+        return;
+
+    AllocInTracker = true; // backtrace() itself could allocate
+
+    if (AllocThreadIdx < 0)
+        AllocThreadIdx = __sync_fetch_and_add(&AllocThreadCount, 1);
+
+    if (AllocThreadIdx < AllocMaxThreads)
+        __sync_fetch_and_add(&AllocPerThread[AllocThreadIdx], 1);
+
+    // Open addressing hash of the call sites, slots are claimed with a CAS
+    void* site = call_site(caller);
+    size_t h = (size_t(site) >> 2) % AllocMaxSites;
+
+    for (int i = 0; i < AllocMaxSites; i++, h = (h + 1) % AllocMaxSites)
+    {
+        void* cur = __sync_val_compare_and_swap(&AllocSites[h], (void*)0, site);
+
+        if (!cur || cur == site)
+        {
+            __sync_fetch_and_add(&AllocSiteCount[h], 1);
+            break;
+        }
+    }
+    AllocInTracker = false;
+  }
+
+  void* tracked_alloc(size_t size, void* caller) {
+
+    track_allocation(caller);
+    return __libc_malloc(size ? size : 1);
+  }
+
+  void* tracked_new(size_t size, void* caller) {
+
+    void* p = tracked_alloc(size, caller);
+
+    if (!p)
+        abort(); // Exceptions are disabled
+
+    return p;
+  }
+}
+
+extern "C" void* malloc(size_t size) {
+
+  track_allocation(__builtin_return_address(0));
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+
+  track_allocation(__builtin_return_address(0));
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t size) {
+
+  track_allocation(__builtin_return_address(0));
+  return __libc_realloc(p, size);
+}
+
+void* operator new(size_t size) throw(std::bad_alloc) {
+
+  return tracked_new(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc) {
+
+  return tracked_new(size, __builtin_return_address(0));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw() {
+
+  return tracked_alloc(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw() {
+
+  return tracked_alloc(size, __builtin_return_address(0));
+}
+
+void operator delete(void* p) throw() { free(p); }
+void operator delete[](void* p) throw() { free(p); }
+void operator delete(void* p, const std::nothrow_t&) throw() { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) throw() { free(p); }
+
+void alloc_tracking(bool on) {
+
+  AllocTracking = on;
+}
+
+void alloc_print_report() {
+
+  bool wasTracking = AllocTracking;
+  long total = 0;
+
+  AllocTracking = false;
+
+  for (int i = 0; i < Min(int(AllocThreadCount), AllocMaxThreads); i++)
+      total += AllocPerThread[i];
+
+  cerr << "\nHeap allocations while tracking: " << total << endl;
+
+  for (int i = 0; i < Min(int(AllocThreadCount), AllocMaxThreads); i++)
+      if (AllocPerThread[i])
+          cerr << "  thread #" << i << ": " << AllocPerThread[i] << endl;
+
+  // Call sites in descending count order, selection sort is enough here
+  while (true)
+  {
+      int best = -1;
+
+      for (int i = 0; i < AllocMaxSites; i++)
+          if (AllocSiteCount[i] && (best < 0 || AllocSiteCount[i] > AllocSiteCount[best]))
+              best = i;
+
+      if (best < 0)
+          break;
+
+      void* site = AllocSites[best];
+      char** sym = backtrace_symbols(&site, 1);
+
+      cerr << "  " << setw(10) << AllocSiteCount[best] << "  "
+           << (site == (void*)1 ? "unknown" : sym ? sym[0] : "?")
+           << " (+" << hex << (char*)site - &__executable_start << dec << ")" << endl;
+
+      free(sym);
+      AllocSiteCount[best] = 0;
+      AllocSites[best] = 0;
+  }
+
+  for (int i = 0; i < AllocMaxThreads; i++)
+      AllocPerThread[i] = 0;
+
+  cerr << endl;
+  AllocTracking = wasTracking;
+}
+
+#else
+
+void alloc_tracking(bool) {}
+void alloc_print_report() {}
+
+#endif
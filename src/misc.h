@@ -26,9 +26,17 @@
 extern const std::string engine_name();
 extern const std::string engine_authors();
 extern int get_system_time();
+extern int64_t get_monotonic_time();
 extern int cpu_count();
 extern int input_available();
 extern void prefetch(char* addr);
+extern int numa_node_count();
+extern int current_numa_node();
+extern void* alloc_interleaved(size_t size);
+extern void* alloc_on_node(size_t size, int node);
+extern void free_numa(void* mem, size_t size);
+extern void alloc_tracking(bool on);
+extern void alloc_print_report();
 
 extern void dbg_hit_on(bool b);
 extern void dbg_hit_on_c(bool c, bool b);
@@ -18,11 +18,11 @@
 */
 
 #include <cassert>
+#include <cstdio>
 #include <cstring>
-#include <iomanip>
 #include <string>
-#include <sstream>
 
+#include "bitboard.h"
 #include "move.h"
 #include "movegen.h"
 #include "search.h"
@@ -30,38 +30,54 @@
 using std::string;
 
 namespace {
-  const string time_string(int milliseconds);
-  const string score_string(Value v);
+  char* time_string(int milliseconds, char* buf);
+  char* score_string(Value v, char* buf);
+
+  // write_square() writes the square name at p and returns the next position
+  inline char* write_square(char* p, Square s) {
+    *p++ = file_to_char(square_file(s));
+    *p++ = rank_to_char(square_rank(s));
+    return p;
+  }
 }
 
 
 /// move_to_uci() converts a move to a string in coordinate notation
 /// (g1f3, a7a8q, etc.). The only special case is castling moves, where we
 /// print in the e1g1 notation in normal chess mode, and in e1h1 notation in
-/// Chess960 mode.
+/// Chess960 mode. The string is written in the caller provided buffer, that
+/// must be at least MAX_MOVE_STRING chars long, and a pointer to it is returned.
 
-const string move_to_uci(Move m, bool chess960) {
+char* move_to_uci(Move m, bool chess960, char* buf) {
 
   Square from = move_from(m);
   Square to = move_to(m);
-  string promotion;
+  char* p = buf;
 
   if (m == MOVE_NONE)
-      return "(none)";
+      return strcpy(buf, "(none)");
 
   if (m == MOVE_NULL)
-      return "0000";
+      return strcpy(buf, "0000");
 
-  if (move_is_short_castle(m) && !chess960)
-      return from == SQ_E1 ? "e1g1" : "e8g8";
+  // In normal chess mode castling moves are encoded as king captures rook
+  if (move_is_castle(m) && !chess960)
+      to = make_square(move_is_short_castle(m) ? FILE_G : FILE_C, square_rank(from));
 
-  if (move_is_long_castle(m) && !chess960)
-      return from == SQ_E1 ? "e1c1" : "e8c8";
+  p = write_square(p, from);
+  p = write_square(p, to);
 
   if (move_is_promotion(m))
-      promotion = char(tolower(piece_type_to_char(move_promotion_piece(m))));
+      *p++ = char(tolower(piece_type_to_char(move_promotion_piece(m))));
+
+  *p = 0;
+  return buf;
+}
+
+const string move_to_uci(Move m, bool chess960) {
 
-  return square_to_string(from) + square_to_string(to) + promotion;
+  char buf[MAX_MOVE_STRING];
+  return move_to_uci(m, chess960, buf);
 }
 
 
@@ -73,9 +89,10 @@ Move move_from_uci(const Position& pos, const string& str) {
 
   MoveStack mlist[MAX_MOVES];
   MoveStack* last = generate<MV_LEGAL>(pos, mlist);
+  char buf[MAX_MOVE_STRING];
 
   for (MoveStack* cur = mlist; cur != last; cur++)
-      if (str == move_to_uci(cur->move, pos.is_chess960()))
+      if (str == move_to_uci(cur->move, pos.is_chess960(), buf))
           return cur->move;
 
   return MOVE_NONE;
@@ -83,133 +100,141 @@ Move move_from_uci(const Position& pos, const string& str) {
 
 
 /// move_to_san() takes a position and a move as input, where it is assumed
-/// that the move is a legal move from the position. The return value is
-/// a string containing the move in short algebraic notation.
+/// that the move is a legal move from the position. The move is written in
+/// short algebraic notation in the caller provided buffer, that must be at
+/// least MAX_MOVE_STRING chars long, and a pointer to it is returned.
 
-const string move_to_san(Position& pos, Move m) {
+char* move_to_san(Position& pos, Move m, char* buf) {
 
   assert(pos.is_ok());
   assert(move_is_ok(m));
 
-  MoveStack mlist[MAX_MOVES];
   Square from = move_from(m);
   Square to = move_to(m);
   PieceType pt = pos.type_of_piece_on(from);
-  string san;
+  char* p = buf;
 
   if (m == MOVE_NONE)
-      return "(none)";
+      return strcpy(buf, "(none)");
 
   if (m == MOVE_NULL)
-      return "(null)";
+      return strcpy(buf, "(null)");
 
   if (move_is_long_castle(m))
-      san = "O-O-O";
+      p += strlen(strcpy(p, "O-O-O"));
   else if (move_is_short_castle(m))
-      san = "O-O";
+      p += strlen(strcpy(p, "O-O"));
   else
   {
       if (pt != PAWN)
       {
-          san = piece_type_to_char(pt);
-
-          // Collect all legal moves of piece type 'pt' with destination 'to'
-          MoveStack* last = generate<MV_LEGAL>(pos, mlist);
-          int f = 0, r = 0;
-
-          for (MoveStack* cur = mlist; cur != last; cur++)
-              if (   move_to(cur->move) == to
-                  && pos.type_of_piece_on(move_from(cur->move)) == pt)
-              {
-                  if (square_file(move_from(cur->move)) == square_file(from))
-                      f++;
+          *p++ = piece_type_to_char(pt);
 
-                  if (square_rank(move_from(cur->move)) == square_rank(from))
-                      r++;
-              }
+          // Other pieces of the same type that can legally reach 'to'
+          Bitboard b, others = EmptyBoardBB;
+          b =  pos.attacks_from(pos.piece_on(from), to)
+             & pos.pieces(pt, pos.side_to_move()) & ~SetMaskBB[from];
 
-          assert(f > 0 && r > 0);
+          while (b)
+          {
+              Square s = pop_1st_bit(&b);
+              if (pos.pl_move_is_legal(make_move(s, to)))
+                  set_bit(&others, s);
+          }
 
           // Disambiguation if we have more then one piece with destination 'to'
-          if (f == 1 && r > 1)
-              san += file_to_char(square_file(from));
-          else if (f > 1 && r == 1)
-              san += rank_to_char(square_rank(from));
-          else if (f > 1 && r > 1)
-              san += square_to_string(from);
+          if (others)
+          {
+              if (!(others & file_bb(from)))
+                  *p++ = file_to_char(square_file(from));
+              else if (!(others & rank_bb(from)))
+                  *p++ = rank_to_char(square_rank(from));
+              else
+                  p = write_square(p, from);
+          }
       }
 
       if (pos.move_is_capture(m))
       {
           if (pt == PAWN)
-              san += file_to_char(square_file(from));
+              *p++ = file_to_char(square_file(from));
 
-          san += 'x';
+          *p++ = 'x';
       }
 
-      san += square_to_string(to);
+      p = write_square(p, to);
 
       if (move_is_promotion(m))
       {
-          san += '=';
-          san += piece_type_to_char(move_promotion_piece(m));
+          *p++ = '=';
+          *p++ = piece_type_to_char(move_promotion_piece(m));
       }
   }
 
-  // The move gives check? We don't use pos.move_gives_check() here
-  // because we need to test for a mate after the move is done.
-  StateInfo st;
-  pos.do_move(m, st);
-  if (pos.in_check())
-      san += pos.is_mate() ? "#" : "+";
-  pos.undo_move(m);
+  // The move gives check? We need to test for a mate after the move is done
+  if (pos.move_gives_check(m))
+  {
+      StateInfo st;
+      pos.do_move(m, st);
+      *p++ = pos.is_mate() ? '#' : '+';
+      pos.undo_move(m);
+  }
+
+  *p = 0;
+  return buf;
+}
+
+const string move_to_san(Position& pos, Move m) {
 
-  return san;
+  char buf[MAX_MOVE_STRING];
+  return move_to_san(pos, m, buf);
 }
 
 
 /// pretty_pv() creates a human-readable string from a position and a PV.
 /// It is used to write search information to the log file (which is created
-/// when the UCI parameter "Use Search Log" is "true").
+/// when the UCI parameter "Use Search Log" is "true"). The string is written
+/// in the caller provided buffer, that must be at least MAX_PRETTY_PV_STRING
+/// chars long, so that the search does not allocate, and a pointer to it is
+/// returned.
 
-const string pretty_pv(Position& pos, int depth, Value score, int time, Move pv[]) {
+char* pretty_pv(Position& pos, int depth, Value score, int time, Move pv[], char* buf) {
 
   const int64_t K = 1000;
   const int64_t M = 1000000;
   const int startColumn = 28;
   const size_t maxLength = 80 - startColumn;
-  const string lf = string("\n") + string(startColumn, ' ');
 
   StateInfo state[PLY_MAX_PLUS_2], *st = state;
   Move* m = pv;
-  string san;
-  std::stringstream s;
-  size_t length = 0;
+  char san[MAX_MOVE_STRING], scoreStr[32], timeStr[32];
+  char* p = buf;
+  size_t length = 0, sanLength;
+  int64_t nodes = pos.nodes_searched();
 
   // First print depth, score, time and searched nodes...
-  s << std::setw(2) << depth
-    << std::setw(8) << score_string(score)
-    << std::setw(8) << time_string(time);
-
-  if (pos.nodes_searched() < M)
-      s << std::setw(8) << pos.nodes_searched() / 1 << "  ";
-  else if (pos.nodes_searched() < K * M)
-      s << std::setw(7) << pos.nodes_searched() / K << "K  ";
+  p += sprintf(p, "%2d%8s%8s", depth, score_string(score, scoreStr), time_string(time, timeStr));
+
+  // Nodes could not fit an int, ISO C++ 1998 has no long long format
+  if (nodes < M)
+      p += sprintf(p, "%8.0f  ", double(nodes));
+  else if (nodes < K * M)
+      p += sprintf(p, "%7.0fK  ", double(nodes / K));
   else
-      s << std::setw(7) << pos.nodes_searched() / M << "M  ";
+      p += sprintf(p, "%7.0fM  ", double(nodes / M));
 
   // ...then print the full PV line in short algebraic notation
   while (*m != MOVE_NONE)
   {
-      san = move_to_san(pos, *m);
-      length += san.length() + 1;
+      sanLength = strlen(move_to_san(pos, *m, san));
+      length += sanLength + 1;
 
       if (length > maxLength)
       {
-          length = san.length() + 1;
-          s << lf;
+          length = sanLength + 1;
+          p += sprintf(p, "\n%*s", startColumn, "");
       }
-      s << san << ' ';
+      p += sprintf(p, "%s ", san);
 
       pos.do_move(*m++, *st++);
   }
@@ -217,13 +242,13 @@ const string pretty_pv(Position& pos, int depth, Value score, int time, Move pv[
   // Restore original position before to leave
   while (m != pv) pos.undo_move(*--m);
 
-  return s.str();
+  return buf;
 }
 
 
 namespace {
 
-  const string time_string(int millisecs) {
+  char* time_string(int millisecs, char* buf) {
 
     const int MSecMinute = 1000 * 60;
     const int MSecHour   = 1000 * 60 * 60;
@@ -232,27 +257,24 @@ namespace {
     int minutes =  (millisecs % MSecHour) / MSecMinute;
     int seconds = ((millisecs % MSecHour) % MSecMinute) / 1000;
 
-    std::stringstream s;
-
     if (hours)
-        s << hours << ':';
+        sprintf(buf, "%d:%02d:%02d", hours, minutes, seconds);
+    else
+        sprintf(buf, "%02d:%02d", minutes, seconds);
 
-    s << std::setfill('0') << std::setw(2) << minutes << ':' << std::setw(2) << seconds;
-    return s.str();
+    return buf;
   }
 
 
-  const string score_string(Value v) {
-
-    std::stringstream s;
+  char* score_string(Value v, char* buf) {
 
     if (v >= VALUE_MATE - 200)
-        s << "#" << (VALUE_MATE - v + 1) / 2;
+        sprintf(buf, "#%d", (VALUE_MATE - v + 1) / 2);
     else if (v <= -VALUE_MATE + 200)
-        s << "-#" << (VALUE_MATE + v) / 2;
+        sprintf(buf, "-#%d", (VALUE_MATE + v) / 2);
     else
-        s << std::setprecision(2) << std::fixed << std::showpos << float(v) / PawnValueMidgame;
+        sprintf(buf, "%+.2f", float(v) / PawnValueMidgame);
 
-    return s.str();
+    return buf;
   }
 }
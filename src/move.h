@@ -28,6 +28,14 @@
 // Maximum number of allowed moves per position
 const int MAX_MOVES = 256;
 
+// Size of the buffers used to format a move, in UCI or SAN notation,
+// including the terminating null char.
+const int MAX_MOVE_STRING = 16;
+
+// Size of the buffer used by pretty_pv(): the header, then each move with
+// its separator and, at worst, a line break with the indentation.
+const int MAX_PRETTY_PV_STRING = 64 + PLY_MAX_PLUS_2 * (MAX_MOVE_STRING + 32);
+
 /// A move needs 16 bits to be stored
 ///
 /// bit  0- 5: destination square (from 0 to 63)
@@ -193,9 +201,11 @@ inline bool move_is_ok(Move m) {
 
 class Position;
 
+extern char* move_to_uci(Move m, bool chess960, char* buf);
 extern const std::string move_to_uci(Move m, bool chess960);
 extern Move move_from_uci(const Position& pos, const std::string& str);
+extern char* move_to_san(Position& pos, Move m, char* buf);
 extern const std::string move_to_san(Position& pos, Move m);
-extern const std::string pretty_pv(Position& pos, int depth, Value score, int time, Move pv[]);
+extern char* pretty_pv(Position& pos, int depth, Value score, int time, Move pv[], char* buf);
 
 #endif // !defined(MOVE_H_INCLUDED)
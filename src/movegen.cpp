@@ -42,34 +42,48 @@ namespace {
   template<Color, MoveType>
   MoveStack* generate_pawn_moves(const Position&, MoveStack*, Bitboard, Square);
 
+  template<Color, MoveType>
+  MoveStack* generate_moves(const Position&, MoveStack*);
+
+  template<Color>
+  MoveStack* generate_checks(const Position&, MoveStack*, const CheckInfo&);
+
+  template<Color>
+  MoveStack* generate_evasions(const Position&, MoveStack*);
+
   template<PieceType Pt>
-  inline MoveStack* generate_discovered_checks(const Position& pos, MoveStack* mlist, Square from) {
+  inline MoveStack* generate_discovered_checks(const Position& pos, MoveStack* mlist, Square from, Square ksq) {
 
     assert(Pt != QUEEN);
 
     Bitboard b = pos.attacks_from<Pt>(from) & pos.empty_squares();
     if (Pt == KING)
-    {
-        Square ksq = pos.king_square(opposite_color(pos.side_to_move()));
         b &= ~QueenPseudoAttacks[ksq];
-    }
+
     SERIALIZE_MOVES(b);
     return mlist;
   }
 
+  // generate_direct_checks() generates the non-capture moves of the pieces
+  // of type Pt that land on one of the squares from where a Pt would attack
+  // the enemy king, as precomputed in CheckInfo::checkSq[].
   template<PieceType Pt>
   inline MoveStack* generate_direct_checks(const Position& pos, MoveStack* mlist, Color us,
-                                           Bitboard dc, Square ksq) {
+                                           const CheckInfo& ci) {
     assert(Pt != KING);
 
     Bitboard checkSqs, b;
+    Bitboard dc = ci.dcCandidates;
     Square from;
-    const Square* ptr = pos.piece_list_begin(us, Pt);
+    const uint8_t* ptr = pos.piece_list_begin(us, Pt);
 
-    if ((from = *ptr++) == SQ_NONE)
+    if ((from = Square(*ptr++)) == SQ_NONE)
         return mlist;
 
-    checkSqs = pos.attacks_from<Pt>(ksq) & pos.empty_squares();
+    checkSqs = ci.checkSq[Pt] & pos.empty_squares();
+
+    if (!checkSqs)
+        return mlist;
 
     do
     {
@@ -84,16 +98,16 @@ namespace {
         b = pos.attacks_from<Pt>(from) & checkSqs;
         SERIALIZE_MOVES(b);
 
-    } while ((from = *ptr++) != SQ_NONE);
+    } while ((from = Square(*ptr++)) != SQ_NONE);
 
     return mlist;
   }
 
   template<>
-  FORCE_INLINE MoveStack* generate_direct_checks<PAWN>(const Position& p, MoveStack* m, Color us, Bitboard dc, Square ksq) {
+  FORCE_INLINE MoveStack* generate_direct_checks<PAWN>(const Position& p, MoveStack* m, Color us, const CheckInfo& ci) {
 
-    return (us == WHITE ? generate_pawn_moves<WHITE, MV_CHECK>(p, m, dc, ksq)
-                        : generate_pawn_moves<BLACK, MV_CHECK>(p, m, dc, ksq));
+    return (us == WHITE ? generate_pawn_moves<WHITE, MV_CHECK>(p, m, ci.dcCandidates, ci.ksq)
+                        : generate_pawn_moves<BLACK, MV_CHECK>(p, m, ci.dcCandidates, ci.ksq));
   }
 
   template<PieceType Pt, MoveType Type>
@@ -111,12 +125,12 @@ namespace {
 
     Bitboard b;
     Square from;
-    const Square* ptr = pos.piece_list_begin(us, Pt);
+    const uint8_t* ptr = pos.piece_list_begin(us, Pt);
 
     if (*ptr != SQ_NONE)
     {
         do {
-            from = *ptr;
+            from = Square(*ptr);
             b = pos.attacks_from<Pt>(from) & target;
             SERIALIZE_MOVES(b);
         } while (*++ptr != SQ_NONE);
@@ -153,41 +167,8 @@ MoveStack* generate(const Position& pos, MoveStack* mlist) {
   assert(pos.is_ok());
   assert(!pos.in_check());
 
-  Color us = pos.side_to_move();
-  Bitboard target;
-
-  if (Type == MV_CAPTURE || Type == MV_NON_EVASION)
-      target = pos.pieces_of_color(opposite_color(us));
-  else if (Type == MV_NON_CAPTURE)
-      target = pos.empty_squares();
-  else
-      assert(false);
-
-  if (Type == MV_NON_EVASION)
-  {
-      mlist = generate_piece_moves<PAWN, MV_CAPTURE>(pos, mlist, us, target);
-      mlist = generate_piece_moves<PAWN, MV_NON_CAPTURE>(pos, mlist, us, pos.empty_squares());
-      target |= pos.empty_squares();
-  }
-  else
-      mlist = generate_piece_moves<PAWN, Type>(pos, mlist, us, target);
-
-  mlist = generate_piece_moves<KNIGHT>(pos, mlist, us, target);
-  mlist = generate_piece_moves<BISHOP>(pos, mlist, us, target);
-  mlist = generate_piece_moves<ROOK>(pos, mlist, us, target);
-  mlist = generate_piece_moves<QUEEN>(pos, mlist, us, target);
-  mlist = generate_piece_moves<KING>(pos, mlist, us, target);
-
-  if (Type != MV_CAPTURE)
-  {
-      if (pos.can_castle_kingside(us))
-          mlist = generate_castle_moves<KING_SIDE>(pos, mlist, us);
-
-      if (pos.can_castle_queenside(us))
-          mlist = generate_castle_moves<QUEEN_SIDE>(pos, mlist, us);
-  }
-
-  return mlist;
+  return pos.side_to_move() == WHITE ? generate_moves<WHITE, Type>(pos, mlist)
+                                     : generate_moves<BLACK, Type>(pos, mlist);
 }
 
 // Explicit template instantiations
@@ -198,42 +179,22 @@ template MoveStack* generate<MV_NON_EVASION>(const Position& pos, MoveStack* mli
 
 /// generate_non_capture_checks() generates all pseudo-legal non-captures and knight
 /// underpromotions that give check. Returns a pointer to the end of the move list.
-template<>
-MoveStack* generate<MV_NON_CAPTURE_CHECK>(const Position& pos, MoveStack* mlist) {
+/// The discovered check candidates and the checking squares are taken from the
+/// given CheckInfo, that the caller usually has already computed for the node.
+
+MoveStack* generate_non_capture_checks(const Position& pos, MoveStack* mlist, const CheckInfo& ci) {
 
   assert(pos.is_ok());
   assert(!pos.in_check());
 
-  Bitboard b, dc;
-  Square from;
-  Color us = pos.side_to_move();
-  Square ksq = pos.king_square(opposite_color(us));
-
-  assert(pos.piece_on(ksq) == make_piece(opposite_color(us), KING));
-
-  // Discovered non-capture checks
-  b = dc = pos.discovered_check_candidates(us);
-
-  while (b)
-  {
-     from = pop_1st_bit(&b);
-     switch (pos.type_of_piece_on(from))
-     {
-      case PAWN:   /* Will be generated togheter with pawns direct checks */     break;
-      case KNIGHT: mlist = generate_discovered_checks<KNIGHT>(pos, mlist, from); break;
-      case BISHOP: mlist = generate_discovered_checks<BISHOP>(pos, mlist, from); break;
-      case ROOK:   mlist = generate_discovered_checks<ROOK>(pos, mlist, from);   break;
-      case KING:   mlist = generate_discovered_checks<KING>(pos, mlist, from);   break;
-      default: assert(false); break;
-     }
-  }
+  return pos.side_to_move() == WHITE ? generate_checks<WHITE>(pos, mlist, ci)
+                                     : generate_checks<BLACK>(pos, mlist, ci);
+}
 
-  // Direct non-capture checks
-  mlist = generate_direct_checks<PAWN>(pos, mlist, us, dc, ksq);
-  mlist = generate_direct_checks<KNIGHT>(pos, mlist, us, dc, ksq);
-  mlist = generate_direct_checks<BISHOP>(pos, mlist, us, dc, ksq);
-  mlist = generate_direct_checks<ROOK>(pos, mlist, us, dc, ksq);
-  return  generate_direct_checks<QUEEN>(pos, mlist, us, dc, ksq);
+template<>
+MoveStack* generate<MV_NON_CAPTURE_CHECK>(const Position& pos, MoveStack* mlist) {
+
+  return generate_non_capture_checks(pos, mlist, CheckInfo(pos));
 }
 
 
@@ -245,62 +206,8 @@ MoveStack* generate<MV_EVASION>(const Position& pos, MoveStack* mlist) {
   assert(pos.is_ok());
   assert(pos.in_check());
 
-  Bitboard b, target;
-  Square from, checksq;
-  int checkersCnt = 0;
-  Color us = pos.side_to_move();
-  Square ksq = pos.king_square(us);
-  Bitboard checkers = pos.checkers();
-  Bitboard sliderAttacks = EmptyBoardBB;
-
-  assert(pos.piece_on(ksq) == make_piece(us, KING));
-  assert(checkers);
-
-  // Find squares attacked by slider checkers, we will remove
-  // them from the king evasions set so to early skip known
-  // illegal moves and avoid an useless legality check later.
-  b = checkers;
-  do
-  {
-      checkersCnt++;
-      checksq = pop_1st_bit(&b);
-
-      assert(pos.color_of_piece_on(checksq) == opposite_color(us));
-
-      switch (pos.type_of_piece_on(checksq))
-      {
-      case BISHOP: sliderAttacks |= BishopPseudoAttacks[checksq]; break;
-      case ROOK:   sliderAttacks |= RookPseudoAttacks[checksq];   break;
-      case QUEEN:
-          // In case of a queen remove also squares attacked in the other direction to
-          // avoid possible illegal moves when queen and king are on adjacent squares.
-          if (RookPseudoAttacks[checksq] & (1ULL << ksq))
-              sliderAttacks |= RookPseudoAttacks[checksq] | pos.attacks_from<BISHOP>(checksq);
-          else
-              sliderAttacks |= BishopPseudoAttacks[checksq] | pos.attacks_from<ROOK>(checksq);
-      default:
-          break;
-      }
-  } while (b);
-
-  // Generate evasions for king, capture and non capture moves
-  b = pos.attacks_from<KING>(ksq) & ~pos.pieces_of_color(us) & ~sliderAttacks;
-  from = ksq;
-  SERIALIZE_MOVES(b);
-
-  // Generate evasions for other pieces only if not double check
-  if (checkersCnt > 1)
-      return mlist;
-
-  // Find squares where a blocking evasion or a capture of the
-  // checker piece is possible.
-  target = squares_between(checksq, ksq) | checkers;
-
-  mlist = generate_piece_moves<PAWN, MV_EVASION>(pos, mlist, us, target);
-  mlist = generate_piece_moves<KNIGHT>(pos, mlist, us, target);
-  mlist = generate_piece_moves<BISHOP>(pos, mlist, us, target);
-  mlist = generate_piece_moves<ROOK>(pos, mlist, us, target);
-  return  generate_piece_moves<QUEEN>(pos, mlist, us, target);
+  return pos.side_to_move() == WHITE ? generate_evasions<WHITE>(pos, mlist)
+                                     : generate_evasions<BLACK>(pos, mlist);
 }
 
 
@@ -500,6 +407,144 @@ namespace {
     return mlist;
   }
 
+  // generate_moves(), generate_checks() and generate_evasions()
+  // do the work of the corresponding generate<> with the side to move known
+  // at compile time, so that color dependent lookups and pawn directions are
+  // resolved once per call instead of once per piece type.
+
+  template<Color Us, MoveType Type>
+  MoveStack* generate_moves(const Position& pos, MoveStack* mlist) {
+
+    const Color Them = (Us == WHITE ? BLACK : WHITE);
+
+    Bitboard target;
+
+    if (Type == MV_CAPTURE || Type == MV_NON_EVASION)
+        target = pos.pieces_of_color(Them);
+    else if (Type == MV_NON_CAPTURE)
+        target = pos.empty_squares();
+    else
+        assert(false);
+
+    if (Type == MV_NON_EVASION)
+    {
+        mlist = generate_piece_moves<PAWN, MV_CAPTURE>(pos, mlist, Us, target);
+        mlist = generate_piece_moves<PAWN, MV_NON_CAPTURE>(pos, mlist, Us, pos.empty_squares());
+        target |= pos.empty_squares();
+    }
+    else
+        mlist = generate_piece_moves<PAWN, Type>(pos, mlist, Us, target);
+
+    mlist = generate_piece_moves<KNIGHT>(pos, mlist, Us, target);
+    mlist = generate_piece_moves<BISHOP>(pos, mlist, Us, target);
+    mlist = generate_piece_moves<ROOK>(pos, mlist, Us, target);
+    mlist = generate_piece_moves<QUEEN>(pos, mlist, Us, target);
+    mlist = generate_piece_moves<KING>(pos, mlist, Us, target);
+
+    if (Type != MV_CAPTURE)
+    {
+        if (pos.can_castle_kingside(Us))
+            mlist = generate_castle_moves<KING_SIDE>(pos, mlist, Us);
+
+        if (pos.can_castle_queenside(Us))
+            mlist = generate_castle_moves<QUEEN_SIDE>(pos, mlist, Us);
+    }
+
+    return mlist;
+  }
+
+  template<Color Us>
+  MoveStack* generate_checks(const Position& pos, MoveStack* mlist, const CheckInfo& ci) {
+
+    Bitboard b = ci.dcCandidates;
+    Square from;
+
+    assert(pos.piece_on(ci.ksq) == make_piece(opposite_color(Us), KING));
+    assert(ci.dcCandidates == pos.discovered_check_candidates(Us));
+
+    // Discovered non-capture checks
+    while (b)
+    {
+       from = pop_1st_bit(&b);
+       switch (pos.type_of_piece_on(from))
+       {
+        case PAWN:   /* Will be generated togheter with pawns direct checks */     break;
+        case KNIGHT: mlist = generate_discovered_checks<KNIGHT>(pos, mlist, from, ci.ksq); break;
+        case BISHOP: mlist = generate_discovered_checks<BISHOP>(pos, mlist, from, ci.ksq); break;
+        case ROOK:   mlist = generate_discovered_checks<ROOK>(pos, mlist, from, ci.ksq);   break;
+        case KING:   mlist = generate_discovered_checks<KING>(pos, mlist, from, ci.ksq);   break;
+        default: assert(false); break;
+       }
+    }
+
+    // Direct non-capture checks
+    mlist = generate_direct_checks<PAWN>(pos, mlist, Us, ci);
+    mlist = generate_direct_checks<KNIGHT>(pos, mlist, Us, ci);
+    mlist = generate_direct_checks<BISHOP>(pos, mlist, Us, ci);
+    mlist = generate_direct_checks<ROOK>(pos, mlist, Us, ci);
+    return  generate_direct_checks<QUEEN>(pos, mlist, Us, ci);
+  }
+
+  template<Color Us>
+  MoveStack* generate_evasions(const Position& pos, MoveStack* mlist) {
+
+    Bitboard b, target;
+    Square from, checksq;
+    int checkersCnt = 0;
+    Square ksq = pos.king_square(Us);
+    Bitboard checkers = pos.checkers();
+    Bitboard sliderAttacks = EmptyBoardBB;
+
+    assert(pos.piece_on(ksq) == make_piece(Us, KING));
+    assert(checkers);
+
+    // Find squares attacked by slider checkers, we will remove
+    // them from the king evasions set so to early skip known
+    // illegal moves and avoid an useless legality check later.
+    b = checkers;
+    do
+    {
+        checkersCnt++;
+        checksq = pop_1st_bit(&b);
+
+        assert(pos.color_of_piece_on(checksq) == opposite_color(Us));
+
+        switch (pos.type_of_piece_on(checksq))
+        {
+        case BISHOP: sliderAttacks |= BishopPseudoAttacks[checksq]; break;
+        case ROOK:   sliderAttacks |= RookPseudoAttacks[checksq];   break;
+        case QUEEN:
+            // In case of a queen remove also squares attacked in the other direction to
+            // avoid possible illegal moves when queen and king are on adjacent squares.
+            if (RookPseudoAttacks[checksq] & (1ULL << ksq))
+                sliderAttacks |= RookPseudoAttacks[checksq] | pos.attacks_from<BISHOP>(checksq);
+            else
+                sliderAttacks |= BishopPseudoAttacks[checksq] | pos.attacks_from<ROOK>(checksq);
+        default:
+            break;
+        }
+    } while (b);
+
+    // Generate evasions for king, capture and non capture moves
+    b = pos.attacks_from<KING>(ksq) & ~pos.pieces_of_color(Us) & ~sliderAttacks;
+    from = ksq;
+    SERIALIZE_MOVES(b);
+
+    // Generate evasions for other pieces only if not double check
+    if (checkersCnt > 1)
+        return mlist;
+
+    // Find squares where a blocking evasion or a capture of the
+    // checker piece is possible.
+    target = squares_between(checksq, ksq) | checkers;
+
+    mlist = generate_piece_moves<PAWN, MV_EVASION>(pos, mlist, Us, target);
+    mlist = generate_piece_moves<KNIGHT>(pos, mlist, Us, target);
+    mlist = generate_piece_moves<BISHOP>(pos, mlist, Us, target);
+    mlist = generate_piece_moves<ROOK>(pos, mlist, Us, target);
+    return  generate_piece_moves<QUEEN>(pos, mlist, Us, target);
+  }
+
   template<CastlingSide Side>
   MoveStack* generate_castle_moves(const Position& pos, MoveStack* mlist, Color us) {
 
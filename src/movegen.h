@@ -37,4 +37,6 @@ enum MoveType {
 template<MoveType>
 MoveStack* generate(const Position& pos, MoveStack* mlist);
 
+MoveStack* generate_non_capture_checks(const Position& pos, MoveStack* mlist, const CheckInfo& ci);
+
 #endif // !defined(MOVEGEN_H_INCLUDED)
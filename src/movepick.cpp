@@ -52,10 +52,11 @@ namespace {
 /// to help it to return the presumably good moves first, to decide which
 /// moves to return (in the quiescence search, for instance, we only want to
 /// search captures, promotions and some checks) and about how important good
-/// move ordering is at the current node.
+/// move ordering is at the current node. The quiescence search constructor
+/// also takes the CheckInfo of the position, used to generate the checks.
 
 MovePicker::MovePicker(const Position& p, Move ttm, const History& h,
-                       SearchStack* ss) : pos(p), H(h) {  
+                       SearchStack* ss) : pos(p), H(h), ci(NULL) {  
 
   ttMoves[0].move = ttm ? ttm : (ss->mateKiller && !p.in_check() && p.move_is_pseudo_legal(ss->mateKiller)) ? ss->mateKiller : MOVE_NONE; 
   ttMoves[1].move = (!ss->mateKiller || p.in_check() || !ttm || ss->mateKiller == ttm || !p.move_is_pseudo_legal(ss->mateKiller)) ? MOVE_NONE : ss->mateKiller;
@@ -80,8 +81,8 @@ MovePicker::MovePicker(const Position& p, Move ttm, const History& h,
   go_next_phase();
 }
 
-MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const History& h)
-                      : pos(p), H(h) {  
+MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const History& h,
+                       const CheckInfo& c) : pos(p), H(h), ci(&c) {  
   ttMoves[0].move = ttm ? ttm : MOVE_NONE;
   int searchTT = ttMoves[0].move;
   ttMoves[1].move = MOVE_NONE;
@@ -157,7 +158,7 @@ void MovePicker::go_next_phase() {
       return;
 
   case PH_QCHECKS:
-      lastMove = generate<MV_NON_CAPTURE_CHECK>(pos, moves);
+      lastMove = generate_non_capture_checks(pos, moves, *ci);
       return;
 
   case PH_STOP:
@@ -41,7 +41,7 @@ class MovePicker {
 
 public:
   MovePicker(const Position&, Move, const History&, SearchStack*);
-  MovePicker(const Position&, Move, Depth, const History&);
+  MovePicker(const Position&, Move, Depth, const History&, const CheckInfo&);
   Move get_next_move();
 
 private:
@@ -52,6 +52,7 @@ private:
 
   const Position& pos;
   const History& H; 
+  const CheckInfo* ci;
   MoveStack ttMoves[2], killers[2];
   int phase;
   const uint8_t* phasePtr;
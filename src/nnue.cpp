@@ -0,0 +1,299 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "bitboard.h"
+#include "nnue.h"
+#include "position.h"
+
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/// The network is a simple 768x2 -> 1 perceptron with a clipped ReLU on the
+/// first layer output. The first layer is shared between the two perspectives
+/// and updated incrementally, the output layer weighs the side to move half
+/// first. Weights are stored as little endian integers in a file made of:
+///
+///   magic "STNN", version, input size, hidden size (4 x 32 bits)
+///   first layer biases [NNHiddenSize] and weights [NNInputSize][NNHiddenSize] (16 bits)
+///   output layer weights [2 * NNHiddenSize] (16 bits)
+///   output bias and output scale (2 x 32 bits)
+
+namespace {
+
+  const uint32_t NNMagic   = 0x4E4E5453; // "STNN"
+  const uint32_t NNVersion = 1;
+
+  // Upper bound of the clipped ReLU activation. It is kept low enough that
+  // the output layer dot product cannot overflow 32 bits.
+  const int NNClip = 127;
+
+  // Max number of incremental updates before we prefer to refresh the
+  // accumulator from scratch.
+  const int MaxUpdatePlies = 12;
+
+  // The SIMD code below uses aligned loads on all the weight arrays, so each
+  // of them must start on a cache line.
+  CACHE_LINE_ALIGNMENT
+  int16_t FeatureWeights[NNInputSize][NNHiddenSize];
+  CACHE_LINE_ALIGNMENT
+  int16_t FeatureBiases[NNHiddenSize];
+  CACHE_LINE_ALIGNMENT
+  int16_t OutputWeights[2 * NNHiddenSize];
+  int32_t OutputBias, OutputScale;
+  bool Loaded;
+
+  // feature_index() returns the input index of piece p on square s as seen
+  // by perspective c. Black perspective is the vertically flipped board with
+  // colors swapped, so the same weights serve both sides.
+  inline int feature_index(Color c, Piece p, Square s) {
+
+    int kind = (color_of_piece(p) == c ? 0 : 6) + int(type_of_piece(p)) - 1;
+    return kind * 64 + int(relative_square(c, s));
+  }
+
+  // add_weights() and sub_weights() update one accumulator half with the
+  // first layer weights column of an input feature.
+  inline void add_weights(int16_t* acc, const int16_t* w) {
+
+#if defined(USE_AVX2)
+    for (int i = 0; i < NNHiddenSize; i += 16)
+    {
+        __m256i* a = (__m256i*)(acc + i);
+        _mm256_storeu_si256(a, _mm256_add_epi16(_mm256_loadu_si256(a), _mm256_load_si256((const __m256i*)(w + i))));
+    }
+#elif defined(USE_SSE2)
+    for (int i = 0; i < NNHiddenSize; i += 8)
+    {
+        __m128i* a = (__m128i*)(acc + i);
+        _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a), _mm_load_si128((const __m128i*)(w + i))));
+    }
+#else
+    for (int i = 0; i < NNHiddenSize; i++)
+        acc[i] += w[i];
+#endif
+  }
+
+  inline void sub_weights(int16_t* acc, const int16_t* w) {
+
+#if defined(USE_AVX2)
+    for (int i = 0; i < NNHiddenSize; i += 16)
+    {
+        __m256i* a = (__m256i*)(acc + i);
+        _mm256_storeu_si256(a, _mm256_sub_epi16(_mm256_loadu_si256(a), _mm256_load_si256((const __m256i*)(w + i))));
+    }
+#elif defined(USE_SSE2)
+    for (int i = 0; i < NNHiddenSize; i += 8)
+    {
+        __m128i* a = (__m128i*)(acc + i);
+        _mm_storeu_si128(a, _mm_sub_epi16(_mm_loadu_si128(a), _mm_load_si128((const __m128i*)(w + i))));
+    }
+#else
+    for (int i = 0; i < NNHiddenSize; i++)
+        acc[i] -= w[i];
+#endif
+  }
+
+  // output_layer() computes the dot product of the clipped accumulator
+  // half with the corresponding output weights.
+  inline int32_t output_layer(const int16_t* acc, const int16_t* w) {
+
+#if defined(USE_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i clip = _mm256_set1_epi16(NNClip);
+    __m256i sum = zero;
+
+    for (int i = 0; i < NNHiddenSize; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(acc + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), clip);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, _mm256_load_si256((const __m256i*)(w + i))));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i clip = _mm_set1_epi16(NNClip);
+    __m128i sum = zero;
+
+    for (int i = 0; i < NNHiddenSize; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(acc + i));
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), clip);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, _mm_load_si128((const __m128i*)(w + i))));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+
+    for (int i = 0; i < NNHiddenSize; i++)
+        sum += Min(Max(acc[i], 0), NNClip) * w[i];
+
+    return sum;
+#endif
+  }
+
+  // refresh_accumulator() computes the first layer output from scratch
+  void refresh_accumulator(const Position& pos, NNAccumulator& nn) {
+
+    Bitboard b = pos.occupied_squares();
+
+    memcpy(nn.values[WHITE], FeatureBiases, sizeof(FeatureBiases));
+    memcpy(nn.values[BLACK], FeatureBiases, sizeof(FeatureBiases));
+
+    while (b)
+    {
+        Square s = pop_1st_bit(&b);
+        Piece p = pos.piece_on(s);
+
+        add_weights(nn.values[WHITE], FeatureWeights[feature_index(WHITE, p, s)]);
+        add_weights(nn.values[BLACK], FeatureWeights[feature_index(BLACK, p, s)]);
+    }
+    nn.computed = true;
+  }
+
+  // update_accumulator() brings the accumulator of the current state up to
+  // date starting from the nearest computed one along the state chain and
+  // replaying the recorded piece changes. Only the current state is written,
+  // the ancestors could be shared with other threads at a split point.
+  void update_accumulator(const Position& pos) {
+
+    StateInfo* path[MaxUpdatePlies];
+    StateInfo *st = pos.state(), *s = st;
+    int n = 0;
+
+    for ( ; !s->nn.computed; s = s->previous)
+        if (!s->previous || n == MaxUpdatePlies)
+        {
+            refresh_accumulator(pos, st->nn);
+            return;
+        }
+        else
+            path[n++] = s;
+
+    memcpy(st->nn.values, s->nn.values, sizeof(st->nn.values));
+
+    while (n--)
+    {
+        const NNAccumulator& d = path[n]->nn;
+
+        for (int i = 0; i < d.dirtyCount; i++)
+            for (Color c = WHITE; c <= BLACK; c++)
+            {
+                if (d.dirtyFrom[i] != SQ_NONE)
+                    sub_weights(st->nn.values[c], FeatureWeights[feature_index(c, d.dirtyPiece[i], d.dirtyFrom[i])]);
+
+                if (d.dirtyTo[i] != SQ_NONE)
+                    add_weights(st->nn.values[c], FeatureWeights[feature_index(c, d.dirtyPiece[i], d.dirtyTo[i])]);
+            }
+    }
+    st->nn.computed = true;
+  }
+
+  // read_le() reads a little endian integer of the given size from the file
+  template<typename T>
+  bool read_le(std::ifstream& f, T* values, size_t count) {
+
+    unsigned char buf[4];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!f.read((char*)buf, sizeof(T)))
+            return false;
+
+        uint32_t v = 0;
+        for (int j = int(sizeof(T)) - 1; j >= 0; j--)
+            v = (v << 8) | buf[j];
+
+        values[i] = T(v);
+    }
+    return true;
+  }
+}
+
+
+/// nnue_load() reads the network weights from the given file. Returns false,
+/// leaving the network unloaded, if the file is missing or malformed.
+
+bool nnue_load(const std::string& fileName) {
+
+  std::ifstream f(fileName.c_str(), std::ios::in | std::ios::binary);
+  uint32_t header[4];
+
+  Loaded = false;
+
+  if (   !f.is_open()
+      || !read_le(f, header, 4)
+      ||  header[0] != NNMagic
+      ||  header[1] != NNVersion
+      ||  header[2] != uint32_t(NNInputSize)
+      ||  header[3] != uint32_t(NNHiddenSize))
+      return false;
+
+  Loaded =   read_le(f, FeatureBiases, NNHiddenSize)
+          && read_le(f, &FeatureWeights[0][0], NNInputSize * NNHiddenSize)
+          && read_le(f, OutputWeights, 2 * NNHiddenSize)
+          && read_le(f, &OutputBias, 1)
+          && read_le(f, &OutputScale, 1)
+          && OutputScale > 0;
+
+  return Loaded;
+}
+
+
+/// nnue_is_loaded() returns true if a valid network is available
+
+bool nnue_is_loaded() {
+
+  return Loaded;
+}
+
+
+/// nnue_evaluate() is the network counterpart of evaluate(). It returns a
+/// score from the point of view of the side to move.
+
+Value nnue_evaluate(const Position& pos) {
+
+  assert(Loaded);
+
+  const NNAccumulator& nn = pos.state()->nn;
+  Color us = pos.side_to_move();
+
+  if (!nn.computed)
+      update_accumulator(pos);
+
+  int32_t sum =  output_layer(nn.values[us], OutputWeights)
+               + output_layer(nn.values[opposite_color(us)], OutputWeights + NNHiddenSize);
+
+  int v = (sum + OutputBias) / OutputScale;
+
+  return Value(Max(Min(v, VALUE_KNOWN_WIN - 1), 1 - VALUE_KNOWN_WIN));
+}
@@ -0,0 +1,53 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(NNUE_H_INCLUDED)
+#define NNUE_H_INCLUDED
+
+#include <string>
+
+#include "types.h"
+
+class Position;
+
+/// Number of inputs of the network: one for each (piece, square) pair, seen
+/// from one side's perspective, and number of first layer neurons for each
+/// perspective.
+const int NNInputSize  = 12 * 64;
+const int NNHiddenSize = 128;
+
+/// NNAccumulator holds the output of the network's first layer for both
+/// perspectives, together with the list of pieces changed by the move that
+/// led to this state. It lives inside StateInfo and is computed lazily:
+/// do_move() only records the changed pieces, while nnue_evaluate() applies
+/// them on top of the nearest ancestor accumulator that is already computed.
+
+struct NNAccumulator {
+  int16_t values[2][NNHiddenSize]; // [perspective][neuron]
+  int dirtyCount;
+  Piece dirtyPiece[3];
+  Square dirtyFrom[3], dirtyTo[3]; // SQ_NONE when the piece is added/removed
+  bool computed;
+};
+
+extern bool nnue_load(const std::string& fileName);
+extern bool nnue_is_loaded();
+extern Value nnue_evaluate(const Position& pos);
+
+#endif // !defined(NNUE_H_INCLUDED)
@@ -18,6 +18,8 @@
 */
 
 #include <cassert>
+#include <cstring>
+#include <iostream>
 
 #include "bitboard.h"
 #include "bitcount.h"
@@ -26,7 +28,7 @@
 
 namespace {
 
-  #define S(mg, eg) make_score(mg, eg)
+  #define S(mg, eg) { mg, eg }
 
   // Doubled pawn penalty by opposed flag and file
   const Score DoubledPawnPenalty[2][8] = {
@@ -65,10 +67,83 @@ namespace {
 
   #undef S
 
-  inline Score apply_weight(Score v, Score w) {
-    return make_score((int(mg_value(v)) * mg_value(w)) / 0x100,
-                      (int(eg_value(v)) * eg_value(w)) / 0x100);
+  // checksum() folds the words of a pawn hash entry, see SharedPawnTable
+  inline uint64_t checksum(const uint64_t* data, int words) {
+
+    uint64_t sum = 0;
+
+    for (int i = 0; i < words; i++)
+        sum ^= data[i];
+
+    return sum;
+  }
+}
+
+SharedPawnTable SharedPawns; // Our global shared pawn hash table
+
+
+/// SharedPawnTable::set_size() allocates the table with the largest power of
+/// two number of entries fitting in mbSize MB. A size of zero frees it.
+
+void SharedPawnTable::set_size(size_t mbSize) {
+
+  size_t newSize = 0;
+
+  if (mbSize)
+      for (newSize = 1024; 2 * newSize * sizeof(Entry) <= (mbSize << 20); newSize *= 2) {}
+
+  if (newSize == size)
+      return;
+
+  free_numa(entries, size * sizeof(Entry));
+  size = 0;
+  entries = NULL;
+
+  if (!newSize)
+      return;
+
+  entries = (Entry*)alloc_interleaved(newSize * sizeof(Entry));
+  if (!entries)
+  {
+      std::cerr << "Failed to allocate " << mbSize
+                << " MB for shared pawn hash table." << std::endl;
+      exit(EXIT_FAILURE);
   }
+  size = newSize;
+}
+
+
+/// SharedPawnTable::probe() copies the entry of the given pawn key into pi and
+/// returns true if it is found and not torn by a concurrent store(). The
+/// check is done on the private copy, so a store() racing after it cannot
+/// corrupt the data we return.
+
+bool SharedPawnTable::probe(Key key, PawnInfo* pi) const {
+
+  const Entry* e = entries + ((uint32_t)key & (size - 1));
+  uint64_t data[Words];
+
+  Key lock = e->lock;
+  memcpy(data, e->data, sizeof(data));
+
+  if ((lock ^ checksum(data, Words)) != key)
+      return false;
+
+  memcpy(pi, data, sizeof(PawnInfo));
+  return true;
+}
+
+
+/// SharedPawnTable::store() writes the pawn info, always replacing
+
+void SharedPawnTable::store(const PawnInfo* pi) {
+
+  Entry* e = entries + ((uint32_t)pi->key & (size - 1));
+  uint64_t data[Words];
+
+  memcpy(data, pi, sizeof(PawnInfo));
+  memcpy(e->data, data, sizeof(data));
+  e->lock = pi->key ^ checksum(data, Words);
 }
 
 
@@ -82,18 +157,25 @@ PawnInfo* PawnInfoTable::get_pawn_info(const Position& pos) const {
   assert(pos.is_ok());
 
   Key key = pos.get_pawn_key();
-  PawnInfo* pi = probe(key);
+  PawnInfo* pi = SharedPawns.enabled() ? &localCopy : probe(key);
+
+  probes++;
 
   // If pi->key matches the position's pawn hash key, it means that we
   // have analysed this pawn structure before, and we can simply return
   // the information we found the last time instead of recomputing it.
-  if (pi->key == key)
+  // With the shared table we first look at our copy of the last entry,
+  // often the same pawn structure, then in the shared table.
+  if (   pi->key == key
+      || (SharedPawns.enabled() && SharedPawns.probe(key, pi)))
+  {
+      hits++;
       return pi;
+  }
 
   // Initialize PawnInfo entry
   pi->key = key;
   pi->passedPawns[WHITE] = pi->passedPawns[BLACK] = 0;
-  pi->kingSquares[WHITE] = pi->kingSquares[BLACK] = SQ_NONE;
   pi->halfOpenFiles[WHITE] = pi->halfOpenFiles[BLACK] = 0xFF;
 
   // Calculate pawn attacks
@@ -103,150 +185,164 @@ PawnInfo* PawnInfoTable::get_pawn_info(const Position& pos) const {
   pi->pawnAttacks[BLACK] = ((bPawns >> 7) & ~FileABB) | ((bPawns >> 9) & ~FileHBB);
 
   // Evaluate pawns for both colors and weight the result
-  pi->value =  evaluate_pawns<WHITE>(pos, wPawns, bPawns, pi)
-             - evaluate_pawns<BLACK>(pos, bPawns, wPawns, pi);
+  pi->value =  evaluate_pawns<WHITE>(wPawns, bPawns, pi)
+             - evaluate_pawns<BLACK>(bPawns, wPawns, pi);
 
   pi->value = apply_weight(pi->value, PawnStructureWeight);
 
+  // Precompute king shelters, passed pawns must be already known
+  evaluate_shelter<WHITE>(wPawns, bPawns, pi);
+  evaluate_shelter<BLACK>(bPawns, wPawns, pi);
+
+  if (SharedPawns.enabled())
+      SharedPawns.store(pi);
+
   return pi;
 }
 
 
-/// PawnInfoTable::evaluate_pawns() evaluates each pawn of the given color
+/// PawnInfoTable::evaluate_pawns() evaluates all the pawns of the given color.
+/// Pawn properties are computed set-wise on whole bitboards with fills, so
+/// that the cost does not depend on the number of pawns.
 
 template<Color Us>
-Score PawnInfoTable::evaluate_pawns(const Position& pos, Bitboard ourPawns,
-                                    Bitboard theirPawns, PawnInfo* pi) {
+Score PawnInfoTable::evaluate_pawns(Bitboard ourPawns, Bitboard theirPawns, PawnInfo* pi) {
 
   const BitCountType Max15 = CpuIs64Bit ? CNT64_MAX15 : CNT32_MAX15;
   const Color Them = (Us == WHITE ? BLACK : WHITE);
 
-  Bitboard b;
+  Bitboard b, passed, isolated, doubled, opposed, chain, backward, candidates;
   Square s;
-  File f;
-  Rank r;
-  bool passed, isolated, doubled, opposed, chain, backward, candidate;
   Score value = SCORE_ZERO;
-  const Square* ptr = pos.piece_list_begin(Us, PAWN);
 
-  // Loop through all pawns of the current color and score each pawn
-  while ((s = *ptr++) != SQ_NONE)
+  // Squares strictly in front of our pawns and strictly behind them, squares
+  // strictly in front of their pawns from their point of view and files
+  // with at least one of our pawns.
+  Bitboard ourFront   = shift_forward<Us>(front_fill<Us>(ourPawns));
+  Bitboard ourRear    = shift_forward<Them>(front_fill<Them>(ourPawns));
+  Bitboard theirFront = shift_forward<Them>(front_fill<Them>(theirPawns));
+  Bitboard ourFiles   = file_fill(ourPawns);
+
+  // These files cannot be half open
+  pi->halfOpenFiles[Us] &= ~int(ourFiles & 0xFF);
+
+  // Flag the pawns as passed, isolated, doubled or member of a pawn
+  // chain (but not the backward one). A pawn is member of a chain if
+  // there is a friendly pawn beside it or one rank behind it on the
+  // neighboring files.
+  passed   = ourPawns & ~(theirFront | shift_sideways(theirFront));
+  doubled  = ourPawns & ourRear;
+  opposed  = ourPawns & theirFront;
+  isolated = ourPawns & ~shift_sideways(ourFiles);
+  chain    = ourPawns & shift_sideways(ourPawns | shift_forward<Us>(ourPawns));
+
+  // A pawn that is passed, isolated, member of a pawn chain, that has
+  // friendly pawns behind on neighboring files or that can capture an
+  // enemy pawn cannot be backward. Otherwise it is backward if, looking in
+  // the forward direction on the neighboring files, the first enemy pawn is
+  // at most one rank farther than the first friendly pawn. We find such pawns
+  // filling backward from two ranks behind the enemy pawns, the fill being
+  // stopped by friendly pawns on the neighboring files.
+  Bitboard ourSides = shift_sideways(ourPawns);
+
+  b = shift_forward<Them>(shift_forward<Them>(shift_sideways(theirPawns)));
+
+  for (int i = 0; i < 4; i++)
+      b |= shift_forward<Them>(b & ~ourSides);
+
+  backward =  ourPawns & b & ~(passed | isolated | chain)
+            & ~shift_sideways(ourFront)
+            & ~pi->pawnAttacks[Them];
+
+  // Passed pawns from the fifth rank on block the half open files of the enemy
+  b = passed & in_front_bb(Us, relative_rank(Us, RANK_4));
+  pi->halfOpenFiles[Them] &= ~int(file_fill(b) & 0xFF);
+
+  // Passed pawns will be properly scored in evaluation because we need
+  // full attack info to evaluate passed pawns. Only the frontmost passed
+  // pawn on each file is considered a true passed pawn.
+  pi->passedPawns[Us] |= passed & ~doubled;
+
+  // Score the pawns, penalties depend on file and opposed flag
+  for (b = isolated; b; )
   {
-      assert(pos.piece_on(s) == make_piece(Us, PAWN));
-
-      f = square_file(s);
-      r = square_rank(s);
-
-	  // This file cannot be half open      
-	  pi->halfOpenFiles[Us] &= ~(1 << f);
-
-      // Our rank plus previous one. Used for chain detection
-      b = rank_bb(r) | rank_bb(Us == WHITE ? r - Rank(1) : r + Rank(1));
-
-      // Flag the pawn as passed, isolated, doubled or member of a pawn
-      // chain (but not the backward one).
-      passed   = !(theirPawns & passed_pawn_mask(Us, s));
-      doubled  =   ourPawns   & squares_in_front_of(Us, s);
-      opposed  =   theirPawns & squares_in_front_of(Us, s);
-      isolated = !(ourPawns   & neighboring_files_bb(f));
-      chain    =   ourPawns   & neighboring_files_bb(f) & b;
-
-      // Test for backward pawn
-      backward = false;
-
-      // If the pawn is passed, isolated, or member of a pawn chain it cannot
-      // be backward. If there are friendly pawns behind on neighboring files
-      // or if can capture an enemy pawn it cannot be backward either.
-      if (   !(passed | isolated | chain)
-          && !(ourPawns & attack_span_mask(Them, s))
-          && !(pos.attacks_from<PAWN>(s, Us) & theirPawns))
-      {
-          // We now know that there are no friendly pawns beside or behind this
-          // pawn on neighboring files. We now check whether the pawn is
-          // backward by looking in the forward direction on the neighboring
-          // files, and seeing whether we meet a friendly or an enemy pawn first.
-          b = pos.attacks_from<PAWN>(s, Us);
-
-          // Note that we are sure to find something because pawn is not passed
-          // nor isolated, so loop is potentially infinite, but it isn't.
-          while (!(b & (ourPawns | theirPawns)))
-              Us == WHITE ? b <<= 8 : b >>= 8;
-
-          // The friendly pawn needs to be at least two ranks closer than the
-          // enemy pawn in order to help the potentially backward pawn advance.
-          backward = (b | (Us == WHITE ? b << 8 : b >> 8)) & theirPawns;
-      }
+      s = pop_1st_bit(&b);
+      value -= IsolatedPawnPenalty[bit_is_set(opposed, s) != 0][square_file(s)];
+  }
+
+  for (b = doubled; b; )
+  {
+      s = pop_1st_bit(&b);
+      value -= DoubledPawnPenalty[bit_is_set(opposed, s) != 0][square_file(s)];
+  }
+
+  for (b = backward; b; )
+  {
+      s = pop_1st_bit(&b);
+      value -= BackwardPawnPenalty[bit_is_set(opposed, s) != 0][square_file(s)];
+  }
+
+  for (b = chain; b; )
+      value += ChainBonus[square_file(pop_1st_bit(&b))];
 
-      assert(opposed | passed | (attack_span_mask(Us, s) & theirPawns));
-
-      // A not passed pawn is a candidate to become passed if it is free to
-      // advance and if the number of friendly pawns beside or behind this
-      // pawn on neighboring files is higher or equal than the number of
-      // enemy pawns in the forward direction on the neighboring files.
-      candidate =   !(opposed | passed | backward | isolated)
-                 && (b = attack_span_mask(Them, s + pawn_push(Us)) & ourPawns) != EmptyBoardBB
-                 &&  count_1s<Max15>(b) >= count_1s<Max15>(attack_span_mask(Us, s) & theirPawns);
-	  
-	  if (passed && relative_rank(Us, s) >= RANK_5)
-		  pi->halfOpenFiles[Them] &= ~(1 << f);
-	  
-      // Passed pawns will be properly scored in evaluation because we need
-      // full attack info to evaluate passed pawns. Only the frontmost passed
-      // pawn on each file is considered a true passed pawn.
-      if (passed && !doubled)
-          set_bit(&(pi->passedPawns[Us]), s);
-
-      // Score this pawn
-      if (isolated)
-		  value -= IsolatedPawnPenalty[opposed][f];
-
-      if (doubled)
-          value -= DoubledPawnPenalty[opposed][f];
-
-      if (backward)
-          value -= BackwardPawnPenalty[opposed][f];
-
-      if (chain)
-          value += ChainBonus[f];
-
-      if (candidate)
+  // A not passed pawn is a candidate to become passed if it is free to
+  // advance and if the number of friendly pawns beside or behind this
+  // pawn on neighboring files is higher or equal than the number of
+  // enemy pawns in the forward direction on the neighboring files.
+  candidates = ourPawns & ~(opposed | passed | backward | isolated);
+
+  while (candidates)
+  {
+      s = pop_1st_bit(&candidates);
+      b = attack_span_mask(Them, s + pawn_push(Us)) & ourPawns;
+
+      if (b && count_1s<Max15>(b) >= count_1s<Max15>(attack_span_mask(Us, s) & theirPawns))
           value += CandidateBonus[relative_rank(Us, s)];
   }
   return value;
 }
 
 
-/// PawnInfo::updateShelter() calculates and caches king shelter. It is called
-/// only when king square changes, about 20% of total king_shelter() calls.
+/// PawnInfoTable::evaluate_shelter() computes the king shelter for every king
+/// file and for the king on each of the first four relative ranks, so that
+/// king_shelter() is a plain table read whatever the king position. Shelter
+/// counts our pawns on three ranks starting from the king's own rank (from the
+/// second rank when the king is on the first one) on the king file and the
+/// neighboring ones, minus half the enemy non-passed pawns one rank farther,
+/// with weights decreasing with the distance from the king.
+
 template<Color Us>
-Score PawnInfo::updateShelter(const Position& pos, Square ksq) {
+void PawnInfoTable::evaluate_shelter(Bitboard ourPawns, Bitboard theirPawns, PawnInfo* pi) {
 
-  const int Shift = (Us == WHITE ? 8 : -8);
   const Color Them = (Us == WHITE ? BLACK : WHITE);
 
-  Bitboard pawnsUs, pawnsThem;
-  int r, m, shelter = 0;
-  int rk = relative_rank(Us, ksq);
-
-  if (rk <= RANK_4)
-  {      
-	  pawnsUs = pos.pieces(PAWN, Us) & this_and_neighboring_files_bb(ksq);
-	  pawnsThem = pos.pieces(PAWN, Them) & ~passed_pawns(Them) & this_and_neighboring_files_bb(ksq);	  
-	 	  
-	  r = (ksq & 56) + (rk ? 0 : Shift);
-  
-      for (int i = 0; i < 3; i++, r += Shift)
-	  {
-		  m = (64 >> (Max(0, rk - i) + i));
-		  shelter += (BitCount8Bit[(pawnsUs >> r) & 0xFF] * m 
-		          - BitCount8Bit[(pawnsThem >> (r + Shift)) & 0xFF] * m / 2); 						 
-	  }
+  int ourRows[8], theirRows[8], files, shelter, r, m;
+
+  theirPawns &= ~pi->passedPawns[Them];
+
+  // Pawns on each rank, indexed by relative rank
+  for (Rank rk = RANK_1; rk <= RANK_8; rk++)
+  {
+      ourRows[rk]   = int(ourPawns   >> (8 * relative_rank(Us, rk))) & 0xFF;
+      theirRows[rk] = int(theirPawns >> (8 * relative_rank(Us, rk))) & 0xFF;
+  }
+
+  for (File f = FILE_A; f <= FILE_H; f++)
+  {
+      files = int(this_and_neighboring_files_bb(f) & 0xFF);
+
+      for (Rank rk = RANK_1; rk <= RANK_4; rk++)
+      {
+          shelter = 0;
+
+          for (int i = 0; i < 3; i++)
+          {
+              r = Max(rk, RANK_2) + i;
+              m = 64 >> Max(int(rk), i);
+              shelter += BitCount8Bit[ourRows[r] & files] * m
+                       - BitCount8Bit[theirRows[r + 1] & files] * m / 2;
+          }
+          pi->kingShelters[Us][f][rk] = int16_t(shelter);
+      }
   }
-  kingSquares[Us] = ksq;
-  kingShelters[Us] = make_score(shelter, 0);
-  return kingShelters[Us];
 }
-
-// Explicit template instantiation
-template Score PawnInfo::updateShelter<WHITE>(const Position& pos, Square ksq);
-template Score PawnInfo::updateShelter<BLACK>(const Position& pos, Square ksq);
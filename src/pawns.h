@@ -20,6 +20,7 @@
 #if !defined(PAWNS_H_INCLUDED)
 #define PAWNS_H_INCLUDED
 
+#include "misc.h"
 #include "position.h"
 #include "tt.h"
 #include "types.h"
@@ -36,6 +37,7 @@ const int PawnTableSize = 16384;
 class PawnInfo {
 
   friend class PawnInfoTable;
+  friend class SharedPawnTable;
 
 public:
   Score pawns_value() const;
@@ -47,32 +49,73 @@ public:
   int any_file_is_open() const;
 
   template<Color Us>
-  Score king_shelter(const Position& pos, Square ksq);
+  Score king_shelter(Square ksq) const;
 
 private:
-  template<Color Us>
-  Score updateShelter(const Position& pos, Square ksq);
-
   Key key;
   Bitboard passedPawns[2];
   Bitboard pawnAttacks[2];
-  Square kingSquares[2];
   Score value;
   int halfOpenFiles[2];
-  Score kingShelters[2];
+  int16_t kingShelters[2][8][4]; // [color][king file][king relative rank]
+};
+
+
+/// SharedPawnTable is an optional pawn hash table shared by all the threads,
+/// enabled by "Shared Pawn Hash" option (size in MB, 0 means per-thread
+/// tables). It is much larger than the per-thread ones and its memory is
+/// interleaved among the NUMA nodes. Access is lockless: each entry stores
+/// its pawn key xored with a checksum of the data, so an entry torn by a
+/// concurrent write fails verification and is treated as a miss. Entries
+/// are copied out to the caller before use, never returned by pointer.
+
+class SharedPawnTable {
+public:
+  SharedPawnTable() : size(0), entries(NULL) {}
+  ~SharedPawnTable() { set_size(0); }
+
+  void set_size(size_t mbSize);
+  bool enabled() const { return size != 0; }
+  bool probe(Key key, PawnInfo* pi) const;
+  void store(const PawnInfo* pi);
+  void prefetch(Key key) const { ::prefetch((char*)(entries + ((uint32_t)key & (size - 1)))); }
+
+private:
+  static const int Words = sizeof(PawnInfo) / sizeof(uint64_t);
+
+  struct Entry {
+    Key lock;
+    uint64_t data[Words];
+  };
+
+  size_t size;
+  Entry* entries;
 };
 
+extern SharedPawnTable SharedPawns;
+
 
 /// The PawnInfoTable class represents a pawn hash table. The most important
 /// method is get_pawn_info, which returns a pointer to a PawnInfo object.
+/// When the shared table is enabled the per-thread table is not allocated
+/// and the returned pointer is to a thread local copy, valid until the next
+/// call.
 
 class PawnInfoTable : public SimpleHash<PawnInfo, PawnTableSize> {
 public:
   PawnInfo* get_pawn_info(const Position& pos) const;
+  void prefetch(Key key) const { SharedPawns.enabled() ? SharedPawns.prefetch(key) : Base::prefetch(key); }
+
+  mutable int64_t probes, hits; // Statistics of the last search, see benchmark()
 
 private:
+  mutable PawnInfo localCopy;
+
+  template<Color Us>
+  static Score evaluate_pawns(Bitboard ourPawns, Bitboard theirPawns, PawnInfo* pi);
+
   template<Color Us>
-  static Score evaluate_pawns(const Position& pos, Bitboard ourPawns, Bitboard theirPawns, PawnInfo* pi);
+  static void evaluate_shelter(Bitboard ourPawns, Bitboard theirPawns, PawnInfo* pi);
 };
 
 
@@ -105,8 +148,10 @@ inline int PawnInfo::any_file_is_open() const {
 }
 
 template<Color Us>
-inline Score PawnInfo::king_shelter(const Position& pos, Square ksq) {
-  return kingSquares[Us] == ksq ? kingShelters[Us] : updateShelter<Us>(pos, ksq);
+inline Score PawnInfo::king_shelter(Square ksq) const {
+
+  Rank rk = relative_rank(Us, ksq);
+  return rk <= RANK_4 ? make_score(kingShelters[Us][square_file(ksq)][rk], 0) : SCORE_ZERO;
 }
 
 #endif // !defined(PAWNS_H_INCLUDED)
@@ -18,6 +18,7 @@
 */
 
 #include <cassert>
+#include <cstddef>
 #include <cstring>
 #include <fstream>
 #include <map>
@@ -101,6 +102,16 @@ namespace {
   };
 
   PieceLetters pieceLetters;
+
+  // add_dirty_piece() records a piece changed by a move, so that the network
+  // accumulator can be updated lazily at evaluation time.
+  inline void add_dirty_piece(NNAccumulator& nn, Piece p, Square from, Square to) {
+
+    nn.dirtyPiece[nn.dirtyCount] = p;
+    nn.dirtyFrom[nn.dirtyCount] = from;
+    nn.dirtyTo[nn.dirtyCount] = to;
+    nn.dirtyCount++;
+  }
 }
 
 
@@ -198,7 +209,12 @@ void Position::from_fen(const string& fen, bool isChess960) {
   {
       if (pieceLetters.find(token) != pieceLetters.end())
       {
-          put_piece(pieceLetters[token], sq);
+          Piece p = pieceLetters[token];
+
+          if (pieceCount[color_of_piece(p)][type_of_piece(p)] == MaxPieceListSize - 1)
+              goto incorrect_fen;
+
+          put_piece(p, sq);
           sq++;
       }
       else if (isdigit(token))
@@ -710,88 +726,37 @@ bool Position::move_is_legal(const Move m) const {
 
 bool Position::move_is_pseudo_legal(const Move m) const {
 
-  assert(is_ok());  
- 
-  Color us = sideToMove;
-  Color them = opposite_color(sideToMove);
+  assert(is_ok());
+
+  Bitboard ours = pieces_of_color(sideToMove);
   Square from = move_from(m);
   Square to = move_to(m);
-  Piece pc = piece_on(from);
 
   // Use a slower but simpler function for uncommon cases
   if (move_is_special(m))
       return move_is_legal(m);
   if (m & (3 << 12))
 	  return false;
-  
-  // If the from square is not occupied by a piece belonging to the side to
-  // move, the move is obviously not legal.
-  if (pc == PIECE_NONE || color_of_piece(pc) != us)
-      return false;
 
-  // The destination square cannot be occupied by a friendly piece
-  if (piece_on(to) != PIECE_NONE && color_of_piece_on(to) == us)
+  // If the from square is not occupied by a piece belonging to the side to
+  // move, the move is obviously not legal. The destination square cannot
+  // be occupied by a friendly piece.
+  if (!bit_is_set(ours, from) || bit_is_set(ours, to))
       return false;
 
-  // Handle the special case of a pawn move
-  if (type_of_piece(pc) == PAWN)
-  {
-      // Move direction must be compatible with pawn color
-      int direction = to - from;
-      if ((us == WHITE) != (direction > 0))
-          return false;
-
-      // We have already handled promotion moves, so destination
-      // cannot be on the 8/1th rank.
-      if (square_rank(to) == RANK_8 || square_rank(to) == RANK_1)
-          return false;
-
-      // Proceed according to the square delta between the origin and
-      // destination squares.
-      switch (direction)
-      {
-      case DELTA_NW:
-      case DELTA_NE:
-      case DELTA_SW:
-      case DELTA_SE:
-      // Capture. The destination square must be occupied by an enemy
-      // piece (en passant captures was handled earlier).
-          if (color_of_piece_on(to) != them)
-              return false;
-          break;
-
-      case DELTA_N:
-      case DELTA_S:
-      // Pawn push. The destination square must be empty.
-          if (!square_is_empty(to))
-              return false;
-          break;
-
-      case DELTA_NN:
-      // Double white pawn push. The destination square must be on the fourth
-      // rank, and both the destination square and the square between the
-      // source and destination squares must be empty.
-      if (   square_rank(to) != RANK_4
-          || !square_is_empty(to)
-          || !square_is_empty(from + DELTA_N))
-          return false;
-          break;
+  Piece pc = piece_on(from);
 
-      case DELTA_SS:
-      // Double black pawn push. The destination square must be on the fifth
-      // rank, and both the destination square and the square between the
-      // source and destination squares must be empty.
-          if (   square_rank(to) != RANK_5
-              || !square_is_empty(to)
-              || !square_is_empty(from + DELTA_S))
-              return false;
-          break;
+  // The move must have the shape of a move of the piece, as looked up in a
+  // table that already excludes promotions and backward pawn moves. Then the
+  // squares in between, for sliders and pawn double pushes, must be empty.
+  if (   !bit_is_set(PseudoMovesBB[pc][from], to)
+      || (squares_between(from, to) & occupied_squares()))
+      return false;
 
-      default:
-          return false;
-      }
-  }
-  else if (!bit_is_set(attacks_from(pc, from), to))
+  // A pawn captures diagonally an enemy piece (en passant captures were
+  // handled earlier) and pushes straight to an empty square.
+  if (   type_of_piece(pc) == PAWN
+      && (square_file(from) == square_file(to)) != square_is_empty(to))
       return false;
 
   // The move is pseudo-legal, check if it is also legal
@@ -920,8 +885,12 @@ void Position::do_move(Move m, StateInfo& newSt) {
   do_move(m, newSt, ci, move_gives_check(m, ci));
 }
 
+template<Color Us>
 void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveIsCheck) {
 
+  const Color Them = (Us == WHITE ? BLACK : WHITE);
+
+  assert(side_to_move() == Us);
   assert(is_ok());
   assert(move_is_ok(m));
   assert(&newSt != st);
@@ -949,6 +918,8 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
   st = &newSt; 
 
   st->move = m;
+  st->nn.computed = false;
+  st->nn.dirtyCount = 0;
 
   // Update side to move
   key ^= zobSideToMove;
@@ -961,12 +932,10 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
   if (move_is_castle(m))
   {
       st->key = key;
-      do_castle_move(m);
+      do_castle_move<Us>(m);
       return;
   }
 
-  Color us = side_to_move();
-  Color them = opposite_color(us);
   Square from = move_from(m);
   Square to = move_to(m);
   bool ep = move_is_ep(m);
@@ -976,16 +945,18 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
   PieceType pt = type_of_piece(piece);
   PieceType capture = ep ? PAWN : type_of_piece_on(to);
 
-  assert(color_of_piece_on(from) == us);
-  assert(color_of_piece_on(to) == them || square_is_empty(to));
-  assert(!(ep || pm) || piece == make_piece(us, PAWN));
-  assert(!pm || relative_rank(us, to) == RANK_8);
+  assert(color_of_piece_on(from) == Us);
+  assert(color_of_piece_on(to) == Them || square_is_empty(to));
+  assert(!(ep || pm) || piece == make_piece(Us, PAWN));
+  assert(!pm || relative_rank(Us, to) == RANK_8);
+
+  add_dirty_piece(st->nn, piece, from, to);
 
   if (capture)
-      do_capture_move(key, capture, them, to, ep);
+      do_capture_move<Us>(key, capture, to, ep);
   
   // Update hash key
-  key ^= zobrist[us][pt][from] ^ zobrist[us][pt][to];
+  key ^= zobrist[Us][pt][from] ^ zobrist[Us][pt][to];
 
   // Reset en passant square
   if (st->epSquare != SQ_NONE)
@@ -1009,7 +980,7 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
 
   // Move the piece
   Bitboard move_bb = make_move_bb(from, to);
-  do_move_bb(&(byColorBB[us]), move_bb);
+  do_move_bb(&(byColorBB[Us]), move_bb);
   do_move_bb(&(byTypeBB[pt]), move_bb);
   do_move_bb(&(byTypeBB[0]), move_bb); // HACK: byTypeBB[0] == occupied squares
 
@@ -1020,7 +991,7 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
   // becomes stale. This works as long as index[] is accessed just
   // by known occupied squares.
   index[to] = index[from];
-  pieceList[us][pt][index[to]] = to;
+  pieceList[Us][pt][index[to]] = to;
 
   // If the moving piece was a pawn do some special extra work
   if (pt == PAWN)
@@ -1029,12 +1000,12 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
       st->rule50 = 0;
 
       // Update pawn hash key and prefetch in L1/L2 cache
-      st->pawnKey ^= zobrist[us][PAWN][from] ^ zobrist[us][PAWN][to];
+      st->pawnKey ^= zobrist[Us][PAWN][from] ^ zobrist[Us][PAWN][to];
 
       // Set en passant square, only if moved pawn can be captured
       if ((to ^ from) == 16)
       {
-          if (attacks_from<PAWN>(from + (us == WHITE ? DELTA_N : DELTA_S), us) & pieces(PAWN, them))
+          if (attacks_from<PAWN>(from + (Us == WHITE ? DELTA_N : DELTA_S), Us) & pieces(PAWN, Them))
           {
               st->epSquare = Square((int(from) + int(to)) / 2);
               key ^= zobEp[st->epSquare];
@@ -1050,35 +1021,37 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
           // Insert promoted piece instead of pawn
           clear_bit(&(byTypeBB[PAWN]), to);
           set_bit(&(byTypeBB[promotion]), to);
-          board[to] = make_piece(us, promotion);
+          board[to] = make_piece(Us, promotion);
+          st->nn.dirtyTo[0] = SQ_NONE;
+          add_dirty_piece(st->nn, board[to], SQ_NONE, to);
 
           // Update piece counts
-          pieceCount[us][promotion]++;
-          pieceCount[us][PAWN]--;
+          pieceCount[Us][promotion]++;
+          pieceCount[Us][PAWN]--;
 
           // Update material key
-          st->materialKey ^= zobrist[us][PAWN][pieceCount[us][PAWN]];
-          st->materialKey ^= zobrist[us][promotion][pieceCount[us][promotion]-1];
+          st->materialKey ^= zobrist[Us][PAWN][pieceCount[Us][PAWN]];
+          st->materialKey ^= zobrist[Us][promotion][pieceCount[Us][promotion]-1];
 
           // Update piece lists, move the last pawn at index[to] position
           // and shrink the list. Add a new promotion piece to the list.
-          Square lastPawnSquare = pieceList[us][PAWN][pieceCount[us][PAWN]];
+          Square lastPawnSquare = Square(pieceList[Us][PAWN][pieceCount[Us][PAWN]]);
           index[lastPawnSquare] = index[to];
-          pieceList[us][PAWN][index[lastPawnSquare]] = lastPawnSquare;
-          pieceList[us][PAWN][pieceCount[us][PAWN]] = SQ_NONE;
-          index[to] = pieceCount[us][promotion] - 1;
-          pieceList[us][promotion][index[to]] = to;
+          pieceList[Us][PAWN][index[lastPawnSquare]] = lastPawnSquare;
+          pieceList[Us][PAWN][pieceCount[Us][PAWN]] = SQ_NONE;
+          index[to] = pieceCount[Us][promotion] - 1;
+          pieceList[Us][promotion][index[to]] = to;
 
           // Partially revert hash keys update
-          key ^= zobrist[us][PAWN][to] ^ zobrist[us][promotion][to];
-          st->pawnKey ^= zobrist[us][PAWN][to];
+          key ^= zobrist[Us][PAWN][to] ^ zobrist[Us][promotion][to];
+          st->pawnKey ^= zobrist[Us][PAWN][to];
 
           // Partially revert and update incremental scores
-          st->value -= pst(us, PAWN, to);
-          st->value += pst(us, promotion, to);
+          st->value -= pst(Us, PAWN, to);
+          st->value += pst(Us, promotion, to);
 
           // Update material
-          st->npMaterial[us] += PieceValueMidgame[promotion];
+          st->npMaterial[Us] += PieceValueMidgame[promotion];
       }
   }
 
@@ -1101,7 +1074,7 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
   if (moveIsCheck)
   {
       if (ep | pm)
-          st->checkersBB = attackers_to(king_square(them)) & pieces_of_color(us);
+          st->checkersBB = attackers_to(king_square(Them)) & pieces_of_color(Us);
       else
       {
           // Direct checks
@@ -1112,19 +1085,19 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
           if (ci.dcCandidates && bit_is_set(ci.dcCandidates, from))
           {
               if (pt != ROOK)
-                  st->checkersBB |= (attacks_from<ROOK>(ci.ksq) & pieces(ROOK, QUEEN, us));
+                  st->checkersBB |= (attacks_from<ROOK>(ci.ksq) & pieces(ROOK, QUEEN, Us));
 
               if (pt != BISHOP)
-                  st->checkersBB |= (attacks_from<BISHOP>(ci.ksq) & pieces(BISHOP, QUEEN, us));
+                  st->checkersBB |= (attacks_from<BISHOP>(ci.ksq) & pieces(BISHOP, QUEEN, Us));
           }
       }
   }
 
-  st->ksq = king_square(sideToMove);  
+  st->ksq = king_square(Us);
   if (pt == KING)
-	  st->king[sideToMove] |= attacks_from<KING>(from);  // Finish
-  sideToMove = opposite_color(sideToMove); 
-  st->pinned = hidden_checkers<true>(sideToMove);
+	  st->king[Us] |= attacks_from<KING>(from);  // Finish
+  sideToMove = Them;
+  st->pinned = hidden_checkers<true>(Them);
 
   assert(is_ok());
 }
@@ -1133,7 +1106,10 @@ void Position::do_move(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveI
 /// Position::do_capture_move() is a private method used to update captured
 /// piece info. It is called from the main Position::do_move function.
 
-void Position::do_capture_move(Key& key, PieceType capture, Color them, Square to, bool ep) {
+template<Color Us>
+void Position::do_capture_move(Key& key, PieceType capture, Square to, bool ep) {
+
+    const Color Them = (Us == WHITE ? BLACK : WHITE);
 
     assert(capture != KING);
 
@@ -1145,36 +1121,38 @@ void Position::do_capture_move(Key& key, PieceType capture, Color them, Square t
     {
         if (ep) // en passant ?
         {
-            capsq = (them == BLACK)? (to - DELTA_N) : (to - DELTA_S);
+            capsq = (Us == WHITE ? to - DELTA_N : to - DELTA_S);
 
             assert(to == st->epSquare);
-            assert(relative_rank(opposite_color(them), to) == RANK_6);
+            assert(relative_rank(Us, to) == RANK_6);
             assert(piece_on(to) == PIECE_NONE);
-            assert(piece_on(capsq) == make_piece(them, PAWN));
+            assert(piece_on(capsq) == make_piece(Them, PAWN));
 
             board[capsq] = PIECE_NONE;
         }
-        st->pawnKey ^= zobrist[them][PAWN][capsq];
+        st->pawnKey ^= zobrist[Them][PAWN][capsq];
     }
     else
-        st->npMaterial[them] -= PieceValueMidgame[capture];
+        st->npMaterial[Them] -= PieceValueMidgame[capture];
+
+    add_dirty_piece(st->nn, make_piece(Them, capture), capsq, SQ_NONE);
 
     // Remove captured piece
-    clear_bit(&(byColorBB[them]), capsq);
+    clear_bit(&(byColorBB[Them]), capsq);
     clear_bit(&(byTypeBB[capture]), capsq);
     clear_bit(&(byTypeBB[0]), capsq);
 
     // Update hash key
-    key ^= zobrist[them][capture][capsq];
+    key ^= zobrist[Them][capture][capsq];
 
     // Update incremental scores
-    st->value -= pst(them, capture, capsq);
+    st->value -= pst(Them, capture, capsq);
 
     // Update piece count
-    pieceCount[them][capture]--;
+    pieceCount[Them][capture]--;
 
     // Update material hash key
-    st->materialKey ^= zobrist[them][capture][pieceCount[them][capture]];
+    st->materialKey ^= zobrist[Them][capture][pieceCount[Them][capture]];
 
     // Update piece list, move the last piece at index[capsq] position
     //
@@ -1183,10 +1161,10 @@ void Position::do_capture_move(Key& key, PieceType capture, Color them, Square t
     // at the end of the list and not in its original place, it means
     // index[] and pieceList[] are not guaranteed to be invariant to a
     // do_move() + undo_move() sequence.
-    Square lastPieceSquare = pieceList[them][capture][pieceCount[them][capture]];
+    Square lastPieceSquare = Square(pieceList[Them][capture][pieceCount[Them][capture]]);
     index[lastPieceSquare] = index[capsq];
-    pieceList[them][capture][index[lastPieceSquare]] = lastPieceSquare;
-    pieceList[them][capture][pieceCount[them][capture]] = SQ_NONE;
+    pieceList[Them][capture][index[lastPieceSquare]] = lastPieceSquare;
+    pieceList[Them][capture][pieceCount[Them][capture]] = SQ_NONE;
 
     // Reset rule 50 counter
     st->rule50 = 0;
@@ -1198,13 +1176,13 @@ void Position::do_capture_move(Key& key, PieceType capture, Color them, Square t
 /// castling moves are encoded as "king captures friendly rook" moves, for
 /// instance white short castling in a non-Chess960 game is encoded as e1h1.
 
+template<Color Us>
 void Position::do_castle_move(Move m) {
 
   assert(move_is_ok(m));
   assert(move_is_castle(m));
 
-  Color us = side_to_move();
-  Color them = opposite_color(us);
+  const Color Them = (Us == WHITE ? BLACK : WHITE);
 
   // Reset capture field
   st->capturedType = PIECE_TYPE_NONE;
@@ -1214,45 +1192,47 @@ void Position::do_castle_move(Move m) {
   Square rfrom = move_to(m);  // HACK: See comment at beginning of function
   Square kto, rto;
 
-  assert(piece_on(kfrom) == make_piece(us, KING));
-  assert(piece_on(rfrom) == make_piece(us, ROOK));
+  assert(piece_on(kfrom) == make_piece(Us, KING));
+  assert(piece_on(rfrom) == make_piece(Us, ROOK));
 
   // Find destination squares for king and rook
   if (rfrom > kfrom) // O-O
   {
-      kto = relative_square(us, SQ_G1);
-      rto = relative_square(us, SQ_F1);
+      kto = relative_square(Us, SQ_G1);
+      rto = relative_square(Us, SQ_F1);
   } else { // O-O-O
-      kto = relative_square(us, SQ_C1);
-      rto = relative_square(us, SQ_D1);
+      kto = relative_square(Us, SQ_C1);
+      rto = relative_square(Us, SQ_D1);
   }
  
   // Remove pieces from source squares:
-  clear_bit(&(byColorBB[us]), kfrom);
+  clear_bit(&(byColorBB[Us]), kfrom);
   clear_bit(&(byTypeBB[KING]), kfrom);
   clear_bit(&(byTypeBB[0]), kfrom); // HACK: byTypeBB[0] == occupied squares
-  clear_bit(&(byColorBB[us]), rfrom);
+  clear_bit(&(byColorBB[Us]), rfrom);
   clear_bit(&(byTypeBB[ROOK]), rfrom);
   clear_bit(&(byTypeBB[0]), rfrom); // HACK: byTypeBB[0] == occupied squares
 
   // Put pieces on destination squares:
-  set_bit(&(byColorBB[us]), kto);
+  set_bit(&(byColorBB[Us]), kto);
   set_bit(&(byTypeBB[KING]), kto);
   set_bit(&(byTypeBB[0]), kto); // HACK: byTypeBB[0] == occupied squares
-  set_bit(&(byColorBB[us]), rto);
+  set_bit(&(byColorBB[Us]), rto);
   set_bit(&(byTypeBB[ROOK]), rto);
   set_bit(&(byTypeBB[0]), rto); // HACK: byTypeBB[0] == occupied squares
 
   // Update board array
-  Piece king = make_piece(us, KING);
-  Piece rook = make_piece(us, ROOK);
+  Piece king = make_piece(Us, KING);
+  Piece rook = make_piece(Us, ROOK);
   board[kfrom] = board[rfrom] = PIECE_NONE;
   board[kto] = king;
   board[rto] = rook;
+  add_dirty_piece(st->nn, king, kfrom, kto);
+  add_dirty_piece(st->nn, rook, rfrom, rto);
 
   // Update piece lists
-  pieceList[us][KING][index[kfrom]] = kto;
-  pieceList[us][ROOK][index[rfrom]] = rto;
+  pieceList[Us][KING][index[kfrom]] = kto;
+  pieceList[Us][ROOK][index[rfrom]] = rto;
   int tmp = index[rfrom]; // In Chess960 could be rto == kfrom
   index[kto] = index[kfrom];
   index[rto] = tmp;
@@ -1262,8 +1242,8 @@ void Position::do_castle_move(Move m) {
   st->value += pst_delta(rook, rfrom, rto);
 
   // Update hash key
-  st->key ^= zobrist[us][KING][kfrom] ^ zobrist[us][KING][kto];
-  st->key ^= zobrist[us][ROOK][rfrom] ^ zobrist[us][ROOK][rto];
+  st->key ^= zobrist[Us][KING][kfrom] ^ zobrist[Us][KING][kto];
+  st->key ^= zobrist[Us][ROOK][rfrom] ^ zobrist[Us][ROOK][rto];
 
   // Clear en passant square
   if (st->epSquare != SQ_NONE)
@@ -1278,12 +1258,12 @@ void Position::do_castle_move(Move m) {
   st->key ^= zobCastle[st->castleRights];  
 
   // Update checkers BB
-  st->checkersBB = attackers_to(king_square(them)) & pieces_of_color(us);
+  st->checkersBB = attackers_to(king_square(Them)) & pieces_of_color(Us);
 
-  st->ksq = king_square(sideToMove);
+  st->ksq = king_square(Us);
   // Finish
-  sideToMove = opposite_color(sideToMove); 
-  st->pinned = hidden_checkers<true>(sideToMove);
+  sideToMove = Them;
+  st->pinned = hidden_checkers<true>(Them);
 
   assert(is_ok());
 }
@@ -1292,21 +1272,23 @@ void Position::do_castle_move(Move m) {
 /// Position::undo_move() unmakes a move. When it returns, the position should
 /// be restored to exactly the same state as before the move was made.
 
+template<Color Us>
 void Position::undo_move(Move m) {
 
+  const Color Them = (Us == WHITE ? BLACK : WHITE);
+
   assert(is_ok());
   assert(move_is_ok(m));
+  assert(side_to_move() == Them);
 
-  sideToMove = opposite_color(sideToMove);
+  sideToMove = Us;
 
   if (move_is_castle(m))
   {
-      undo_castle_move(m);
+      undo_castle_move<Us>(m);
       return;
   }
 
-  Color us = side_to_move();
-  Color them = opposite_color(us);
   Square from = move_from(m);
   Square to = move_to(m);
   bool ep = move_is_ep(m);
@@ -1315,11 +1297,11 @@ void Position::undo_move(Move m) {
   PieceType pt = type_of_piece_on(to);
 
   assert(square_is_empty(from));
-  assert(color_of_piece_on(to) == us);
-  assert(!pm || relative_rank(us, to) == RANK_8);
+  assert(color_of_piece_on(to) == Us);
+  assert(!pm || relative_rank(Us, to) == RANK_8);
   assert(!ep || to == st->previous->epSquare);
-  assert(!ep || relative_rank(us, to) == RANK_6);
-  assert(!ep || piece_on(to) == make_piece(us, PAWN));
+  assert(!ep || relative_rank(Us, to) == RANK_6);
+  assert(!ep || piece_on(to) == make_piece(Us, PAWN));
 
   if (pm) // promotion ?
   {
@@ -1327,61 +1309,61 @@ void Position::undo_move(Move m) {
       pt = PAWN;
 
       assert(promotion >= KNIGHT && promotion <= QUEEN);
-      assert(piece_on(to) == make_piece(us, promotion));
+      assert(piece_on(to) == make_piece(Us, promotion));
 
       // Replace promoted piece with a pawn
       clear_bit(&(byTypeBB[promotion]), to);
       set_bit(&(byTypeBB[PAWN]), to);
 
       // Update piece counts
-      pieceCount[us][promotion]--;
-      pieceCount[us][PAWN]++;
+      pieceCount[Us][promotion]--;
+      pieceCount[Us][PAWN]++;
 
       // Update piece list replacing promotion piece with a pawn
-      Square lastPromotionSquare = pieceList[us][promotion][pieceCount[us][promotion]];
+      Square lastPromotionSquare = Square(pieceList[Us][promotion][pieceCount[Us][promotion]]);
       index[lastPromotionSquare] = index[to];
-      pieceList[us][promotion][index[lastPromotionSquare]] = lastPromotionSquare;
-      pieceList[us][promotion][pieceCount[us][promotion]] = SQ_NONE;
-      index[to] = pieceCount[us][PAWN] - 1;
-      pieceList[us][PAWN][index[to]] = to;
+      pieceList[Us][promotion][index[lastPromotionSquare]] = lastPromotionSquare;
+      pieceList[Us][promotion][pieceCount[Us][promotion]] = SQ_NONE;
+      index[to] = pieceCount[Us][PAWN] - 1;
+      pieceList[Us][PAWN][index[to]] = to;
   }
 
   // Put the piece back at the source square
   Bitboard move_bb = make_move_bb(to, from);
-  do_move_bb(&(byColorBB[us]), move_bb);
+  do_move_bb(&(byColorBB[Us]), move_bb);
   do_move_bb(&(byTypeBB[pt]), move_bb);
   do_move_bb(&(byTypeBB[0]), move_bb); // HACK: byTypeBB[0] == occupied squares
 
-  board[from] = make_piece(us, pt);
+  board[from] = make_piece(Us, pt);
   board[to] = PIECE_NONE;
 
   // Update piece list
   index[from] = index[to];
-  pieceList[us][pt][index[from]] = from;
+  pieceList[Us][pt][index[from]] = from;
 
   if (st->capturedType)
   {
       Square capsq = to;
 
       if (ep)
-          capsq = (us == WHITE)? (to - DELTA_N) : (to - DELTA_S);
+          capsq = (Us == WHITE ? to - DELTA_N : to - DELTA_S);
 
       assert(st->capturedType != KING);
       assert(!ep || square_is_empty(capsq));
 
       // Restore the captured piece
-      set_bit(&(byColorBB[them]), capsq);
+      set_bit(&(byColorBB[Them]), capsq);
       set_bit(&(byTypeBB[st->capturedType]), capsq);
       set_bit(&(byTypeBB[0]), capsq);
 
-      board[capsq] = make_piece(them, st->capturedType);
+      board[capsq] = make_piece(Them, st->capturedType);
 
       // Update piece count
-      pieceCount[them][st->capturedType]++;
+      pieceCount[Them][st->capturedType]++;
 
       // Update piece list, add a new captured piece in capsq square
-      index[capsq] = pieceCount[them][st->capturedType] - 1;
-      pieceList[them][st->capturedType][index[capsq]] = capsq;
+      index[capsq] = pieceCount[Them][st->capturedType] - 1;
+      pieceList[Them][st->capturedType][index[capsq]] = capsq;
   }
 
   // Finally point our state pointer back to the previous state
@@ -1396,15 +1378,16 @@ void Position::undo_move(Move m) {
 /// castling moves are encoded as "king captures friendly rook" moves, for
 /// instance white short castling in a non-Chess960 game is encoded as e1h1.
 
+template<Color Us>
 void Position::undo_castle_move(Move m) {
 
   assert(move_is_ok(m));
   assert(move_is_castle(m));
 
   // When we have arrived here, some work has already been done by
-  // Position::undo_move.  In particular, the side to move has been switched,
-  // so the code below is correct.
-  Color us = side_to_move();
+  // Position::undo_move.  In particular, the side to move has been switched
+  // back to Us.
+  assert(side_to_move() == Us);
 
   // Find source squares for king and rook
   Square kfrom = move_from(m);
@@ -1414,40 +1397,40 @@ void Position::undo_castle_move(Move m) {
   // Find destination squares for king and rook
   if (rfrom > kfrom) // O-O
   {
-      kto = relative_square(us, SQ_G1);
-      rto = relative_square(us, SQ_F1);
+      kto = relative_square(Us, SQ_G1);
+      rto = relative_square(Us, SQ_F1);
   } else { // O-O-O
-      kto = relative_square(us, SQ_C1);
-      rto = relative_square(us, SQ_D1);
+      kto = relative_square(Us, SQ_C1);
+      rto = relative_square(Us, SQ_D1);
   }
 
-  assert(piece_on(kto) == make_piece(us, KING));
-  assert(piece_on(rto) == make_piece(us, ROOK));
+  assert(piece_on(kto) == make_piece(Us, KING));
+  assert(piece_on(rto) == make_piece(Us, ROOK));
 
   // Remove pieces from destination squares:
-  clear_bit(&(byColorBB[us]), kto);
+  clear_bit(&(byColorBB[Us]), kto);
   clear_bit(&(byTypeBB[KING]), kto);
   clear_bit(&(byTypeBB[0]), kto); // HACK: byTypeBB[0] == occupied squares
-  clear_bit(&(byColorBB[us]), rto);
+  clear_bit(&(byColorBB[Us]), rto);
   clear_bit(&(byTypeBB[ROOK]), rto);
   clear_bit(&(byTypeBB[0]), rto); // HACK: byTypeBB[0] == occupied squares
 
   // Put pieces on source squares:
-  set_bit(&(byColorBB[us]), kfrom);
+  set_bit(&(byColorBB[Us]), kfrom);
   set_bit(&(byTypeBB[KING]), kfrom);
   set_bit(&(byTypeBB[0]), kfrom); // HACK: byTypeBB[0] == occupied squares
-  set_bit(&(byColorBB[us]), rfrom);
+  set_bit(&(byColorBB[Us]), rfrom);
   set_bit(&(byTypeBB[ROOK]), rfrom);
   set_bit(&(byTypeBB[0]), rfrom); // HACK: byTypeBB[0] == occupied squares
 
   // Update board
   board[rto] = board[kto] = PIECE_NONE;
-  board[rfrom] = make_piece(us, ROOK);
-  board[kfrom] = make_piece(us, KING);
+  board[rfrom] = make_piece(Us, ROOK);
+  board[kfrom] = make_piece(Us, KING);
 
   // Update piece lists
-  pieceList[us][KING][index[kto]] = kfrom;
-  pieceList[us][ROOK][index[rto]] = rfrom;
+  pieceList[Us][KING][index[kto]] = kfrom;
+  pieceList[Us][ROOK][index[rto]] = rfrom;
   int tmp = index[rto];  // In Chess960 could be rto == kfrom
   index[kfrom] = index[kto];
   index[rfrom] = tmp;
@@ -1458,6 +1441,12 @@ void Position::undo_castle_move(Move m) {
   assert(is_ok());
 }
 
+// Explicit template instantiations
+template void Position::do_move<WHITE>(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveIsCheck);
+template void Position::do_move<BLACK>(Move m, StateInfo& newSt, const CheckInfo& ci, bool moveIsCheck);
+template void Position::undo_move<WHITE>(Move m);
+template void Position::undo_move<BLACK>(Move m);
+
 
 /// Position::do(undo)_null_move() is used to do(undo) a "null move": It flips
 /// the side to move without executing any move on the board.
@@ -1467,12 +1456,14 @@ void Position::do_null_move(StateInfo& newSt) {
   assert(is_ok());
   assert(!in_check());
 
-  memcpy(&newSt, st, sizeof(StateInfo)); // Fully copy here
+  memcpy(&newSt, st, offsetof(StateInfo, nn)); // Fully copy here, but accumulator
 
   newSt.previous = st;
   st = &newSt;  
 
   st->move = MOVE_NULL;
+  st->nn.computed = false;
+  st->nn.dirtyCount = 0;
 
   // Update the necessary information
   if (st->epSquare != SQ_NONE)
@@ -1669,7 +1660,7 @@ void Position::clear() {
       board[i] = PIECE_NONE;
 
   for (int i = 0; i < 8; i++)
-      for (int j = 0; j < 16; j++)
+      for (int j = 0; j < MaxPieceListSize; j++)
           pieceList[0][i][j] = pieceList[1][i][j] = SQ_NONE;
 
   for (Square sq = SQ_A1; sq <= SQ_H8; sq++)
@@ -1836,8 +1827,71 @@ bool Position::is_draw() const {
 
 bool Position::is_mate() const {
 
-  MoveStack moves[MAX_MOVES];
-  return in_check() && generate<MV_LEGAL>(*this, moves) == moves;
+  return in_check() && !has_legal_move();
+}
+
+
+/// Position::has_legal_move() returns true if the side to move has at least
+/// one legal move. Candidates are tried from the cheapest to verify, king
+/// steps first, then pawn pushes and moves of unpinned pieces, stopping at the
+/// first legal one. Move generation is needed only when all these fail, that
+/// is in (nearly) mated or stalemated positions.
+
+bool Position::has_legal_move() const {
+
+  MoveStack mlist[MAX_MOVES];
+  MoveStack *cur, *last;
+  Color us = side_to_move();
+  Color them = opposite_color(us);
+  Square s, ksq = king_square(us);
+  Bitboard b, target = ~pieces_of_color(us);
+
+  // King steps, removing the king so that it does not shield itself from sliders
+  b = attacks_from<KING>(ksq) & target;
+  while (b)
+      if (!(attackers_to(pop_1st_bit(&b), occupied_squares() ^ SetMaskBB[ksq]) & pieces_of_color(them)))
+          return true;
+
+  if (in_check())
+  {
+      // In double check only the king can move
+      if (checkers() & (checkers() - 1))
+          return false;
+
+      last = generate<MV_EVASION>(*this, mlist);
+  }
+  else
+  {
+      Bitboard pinned = pinned_pieces(us);
+
+      // Pawn pushes, a pinned pawn can be pushed only along the king file
+      b = pieces(PAWN, us) & (~pinned | file_bb(ksq));
+      b = (us == WHITE ? shift_forward<WHITE>(b) : shift_forward<BLACK>(b));
+
+      if (b & ~occupied_squares())
+          return true;
+
+      // Moves of unpinned pieces can not leave the king in check
+      for (PieceType pt = KNIGHT; pt <= QUEEN; pt++)
+      {
+          const uint8_t* ptr = piece_list_begin(us, pt);
+
+          while ((s = Square(*ptr++)) != SQ_NONE)
+              if (!bit_is_set(pinned, s) && (attacks_from(make_piece(us, pt), s) & target))
+                  return true;
+      }
+
+      // Remaining ones are pawn captures, moves of pinned pieces and castling
+      last = generate<MV_NON_EVASION>(*this, mlist);
+  }
+
+  // King steps have already been rejected above
+  for (cur = mlist; cur != last; cur++)
+      if (   (move_from(cur->move) != ksq || move_is_castle(cur->move))
+          && pl_move_is_legal(cur->move))
+          return true;
+
+  return false;
 }
 
 
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -27,6 +28,7 @@
 #include <vector>
 
 #include "book.h"
+#include "cluster.h"
 #include "evaluate.h"
 #include "history.h"
 #include "misc.h"
@@ -72,8 +74,8 @@ namespace {
 	}
 
     void insert_pv_in_tt(Position& pos);
-    std::string pv_info_to_uci(Position& pos, int depth,
-                               Value alpha, Value beta, int pvIdx);
+    char* pv_info_to_uci(Position& pos, int depth, Value alpha,
+                         Value beta, int pvIdx, char* buf);
     uint64_t nodes;
     Value pv_score;    
     Move pv[PLY_MAX_PLUS_2];
@@ -84,6 +86,7 @@ namespace {
   struct RootMoveList : public std::vector<RootMove> {    
 
     void init(Position& pos, Move searchMoves[]);
+    void sort();
 
     int bestMoveChanges;
   };
@@ -155,10 +158,18 @@ namespace {
     return (Depth) Reductions[PV][Min(d / 2, 63)][Min(mn, 63)];
   }
 
+  // Size of the buffer for an "info" line with a PV, the search writes its
+  // output in buffers on the stack to not allocate.
+  const int MaxInfoString = 128 + PLY_MAX_PLUS_2 * 6;
+
   // Easy move margin. An easy move candidate must be at least this much
   // better than the second best move.
   const Value EasyMoveMargin = Value(0x200);
 
+  // Number of root moves scored to choose from when playing with strength
+  // handicap, the MultiPV of the iterations where the move is picked.
+  const int SkillCandidates = 4;
+
 
   /// Namespace variables  
 
@@ -219,20 +230,22 @@ namespace {
   void update_pv(Move* pv, Move move, Move* childPv); 
   bool ok_to_use_TT(const TTEntry* tte, Depth depth, Value beta, int ply);
   bool connected_threat(const Position& pos, Move m, Move threat);
-  bool is_stalemate(const Position& pos);  
   Value refine_eval(const TTEntry* tte, Value defaultEval, int ply);
   void update_history(const Position& pos, Move move, Depth depth, Move movesSearched[], int moveCount);
   void update_gains(const Position& pos, Move move, Value before, Value after);
   void do_skill_level(Move* best, Move* ponder);
 
   int current_search_time(int set = 0);
-  std::string value_to_uci(Value v);
-  std::string speed_to_uci(int64_t nodes);
+  char* value_to_uci(Value v, char* buf);
+  char* speed_to_uci(int64_t nodes, char* buf);
   void poll(const Position& pos);
   void wait_for_stop_or_ponderhit();
 } // namespace
 
 
+IterationHook SearchIterationHook = NULL;
+
+
 /// init_search() is called during startup to initialize various lookup tables
 
 void init_search() {
@@ -257,6 +270,9 @@ void init_search() {
   // Init futility move count array
   for (d = 0; d < 32; d++)
       FutilityMoveCounts[d] = int(3.001 + 0.25 * pow(double(d), 2.0));
+
+  // Room for all the legal moves, so that the search never grows the list
+  Rml.reserve(MAX_MOVES);
 }
 
 
@@ -341,8 +357,12 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
   read_evaluation_uci_options(pos.side_to_move());
   Threads.read_uci_options();
 
-  // If needed allocate pawn and material hash tables and adjust TT size
+  // If needed allocate pawn and material hash tables, grow split point pools
+  // and adjust TT size
+  SharedPawns.set_size(Options["Shared Pawn Hash"].value<int>());
+  replicate_attack_tables(Options["NUMA Replicated Tables"].value<bool>());
   Threads.init_hash_tables();
+  Threads.grow_split_points();
   TT.set_size(Options["Hash"].value<int>());
 
   if (Options["Clear Hash"].value<bool>())
@@ -351,16 +371,26 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
       TT.clear();
   }
 
-  // Do we have to play with skill handicap? In this case enable MultiPV that
-  // we will use behind the scenes to retrieve a set of possible moves.
+  // Accept cluster workers if we are the coordinator
+  if (Options["Cluster Port"].value<int>())
+      cluster_listen(Options["Cluster Interface"].value<std::string>(),
+                     Options["Cluster Port"].value<int>());
+
+  // Do we have to play with skill handicap? In this case the search stops at
+  // the depth where the move is picked, see id_loop().
   SkillLevelEnabled = (SkillLevel < 20);
-  MultiPV = (SkillLevelEnabled ? Max(UCIMultiPV, 4) : UCIMultiPV);
+  MultiPV = UCIMultiPV;
+
+  // Wake up needed threads and reset maxPly and statistics counters
+  Threads.reset_split_statistics();
+  Threads[0].socket = use_local_attack_tables();
 
-  // Wake up needed threads and reset maxPly counter
   for (int i = 0; i < Threads.size(); i++)
   {
 	  Threads[i].wake_up();    
 	  Threads[i].maxPly = 0;        
+	  Threads[i].ttProbes = Threads[i].ttHits = 0;
+	  Threads[i].pawnTable.probes = Threads[i].pawnTable.hits = 0;
   }
 
   // Write to log file and keep it open to be accessed during the search
@@ -379,11 +409,39 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
                   << endl;
   }
 
-  // We're ready to start thinking. Call the iterative deepening loop function
+  // We're ready to start thinking. Call the iterative deepening loop function.
+  // The search should not allocate, this is checked with allocation tracking.
   Move ponderMove = MOVE_NONE;
+
+  alloc_tracking(true);
   Move bestMove = id_loop(pos, searchMoves, &ponderMove);
+  alloc_tracking(false);
+
+  // Collect the results of the cluster workers, waiting for them when the
+  // depth limit has been reached, and play the best of all.
+  cluster_stop_search(pos, !StopRequest && Limits.maxDepth, &bestMove, &ponderMove);
+
+  char buf[MaxInfoString];
+  cout << "info" << speed_to_uci(pos.nodes_searched(), buf) << endl;
+
+  // Adapt the split parameters to the SMP overhead of this search
+  if (Threads.size() > 1)
+  {
+      std::string split = Threads.adapt_split_parameters();
+
+      cout << "info string " << split << endl;
+
+      if (LogFile.is_open())
+          LogFile << "SMP: " << split << endl;
+  }
 
-  cout << "info" << speed_to_uci(pos.nodes_searched()) << endl;
+  // Nodes of the main thread, those of its split points are already counted
+  // by the slaves, see split().
+  Threads[0].socketNodes[Threads[0].socket] += pos.nodes_searched();
+
+  // With replicated tables report the speed of the threads on each node
+  if (Options["NUMA Replicated Tables"].value<bool>())
+      cout << "info string " << Threads.socket_speed() << endl;
 
   // Write final search statistics and close log file
   if (LogFile.is_open())
@@ -436,7 +494,9 @@ namespace {
     int bestMoveChanges[PLY_MAX_PLUS_2];
     int depth, aspirationDelta;
     Value value, alpha, beta;
-    Move bestMove, easyMove, skillBest, skillPonder;	
+    Move bestMove, easyMove, skillBest, skillPonder;
+    bool rootSplit = false;
+    char buf[MaxInfoString];	
 
     // Initialize stuff before a new search
     memset(ss-2, 0, 5 * sizeof(SearchStack));
@@ -454,14 +514,32 @@ namespace {
     if (Rml.size() == 0)
     {
         cout << "info depth 0 score "
-             << value_to_uci(pos.in_check() ? -VALUE_MATE : VALUE_DRAW)
+             << value_to_uci(pos.in_check() ? -VALUE_MATE : VALUE_DRAW, buf)
              << endl;
 
         return MOVE_NONE;
     }
+
+    // Hand out the root moves to the cluster workers, if any, and keep only
+    // our share of them when the root is split.
+    if (ClusterEnabled)
+    {
+        Move rootMoves[MAX_MOVES], ownMoves[MAX_MOVES];
+
+        for (int i = 0; i <= int(Rml.size()); i++)
+            rootMoves[i] = (i < int(Rml.size()) ? Rml[i].pv[0] : MOVE_NONE);
+
+        if ((rootSplit = cluster_start_search(pos, rootMoves, Limits.maxDepth, ownMoves)))
+            Rml.init(pos, ownMoves);
+    }
 	
-    // Iterative deepening loop until requested to stop or target depth reached
-    while (!StopRequest && ++depth <= PLY_MAX && (!Limits.maxDepth || depth <= Limits.maxDepth))
+    // Iterative deepening loop until requested to stop or target depth reached.
+    // With strength handicap there is no point to search beyond the depth at
+    // which the move is picked, so that weak levels are also cheap to run.
+    while (   !StopRequest
+           && ++depth <= PLY_MAX
+           && (!Limits.maxDepth || depth <= Limits.maxDepth)
+           && (!SkillLevelEnabled || depth <= 1 + SkillLevel))
     {
 		if (   depth >= 26
 			&& abs(bestValues[depth - 1]) >= 2 * PawnValueMidgame 
@@ -480,6 +558,12 @@ namespace {
        	if (Limits.maxTime || Limits.infinite)
 			cout << "info depth " << depth << endl;
 
+        // With strength handicap the candidate moves need an exact score at the
+        // depth where the move is picked. That iteration, and the first one to
+        // have a pick to fall back on if stopped earlier, are MultiPV searches.
+        if (SkillLevelEnabled)
+            MultiPV = (depth == 1 || depth == 1 + SkillLevel ? Max(UCIMultiPV, SkillCandidates) : UCIMultiPV);
+
         // Calculate dynamic aspiration window based on previous iterations
         if (MultiPV == 1 && depth >= 5)
         {            
@@ -497,7 +581,12 @@ namespace {
 				alpha = -VALUE_INFINITE;
 				beta = VALUE_INFINITE;
 			}
-        }		
+        }
+        else // MultiPV can change between iterations with strength handicap
+        {
+            alpha = -VALUE_INFINITE;
+            beta = VALUE_INFINITE;
+        }
 
         // Start with a small aspiration window and, in case of fail high/low,
         // research with bigger window until not failing high/low anymore.
@@ -505,7 +594,7 @@ namespace {
             // Search starting from ss+1 to allow calling update_gains()
             value = search<PV, false, true>(pos, ss, alpha, beta, depth * ONE_PLY);
 
-			std::stable_sort(Rml.begin(), Rml.end());					
+			Rml.sort();
 
             // Write PV back to transposition table in case the relevant entries
             // have been overwritten during the search.
@@ -517,7 +606,7 @@ namespace {
                 break;
 
 			if ((Limits.maxTime || Limits.infinite) && (value >= beta || value <= alpha))
-				cout << Rml[0].pv_info_to_uci(pos, depth, alpha, beta, 0) << endl;
+				cout << Rml[0].pv_info_to_uci(pos, depth, alpha, beta, 0, buf) << endl;
 
 			if (LastValue != VALUE_NONE && abs(value - bestValues[depth - 1]) == 1)
 				value = bestValues[depth - 1]; 
@@ -554,19 +643,31 @@ namespace {
         bestValues[depth] = value;
         bestMoveChanges[depth] = Rml.bestMoveChanges;
 
-        // Do we need to pick now the best and the ponder moves ?
-        if (SkillLevelEnabled && depth == 1 + SkillLevel)
+        if (SearchIterationHook)
+            SearchIterationHook(depth, bestMove, value, pos.nodes_searched(), current_search_time());
+
+        // Only full iterations can be compared with the ones of the workers
+        if (ClusterEnabled && !StopRequest)
+            cluster_iteration(depth, Rml[0].pv_score, Rml[0].pv, pos.is_chess960());
+
+        // Do we need to pick now the best and the ponder moves ? Scores of an
+        // interrupted iteration cannot be trusted, the last pick is kept.
+        if (SkillLevelEnabled && MultiPV > 1 && !StopRequest)
             do_skill_level(&skillBest, &skillPonder);
         
         // Send PV line to GUI and to log file
         for (int i = 0; i < Min(UCIMultiPV, (int)Rml.size()); i++)
-            cout << Rml[i].pv_info_to_uci(pos, depth, alpha, beta, i) << endl;
+            cout << Rml[i].pv_info_to_uci(pos, depth, alpha, beta, i, buf) << endl;
 
         if (LogFile.is_open())
-            LogFile << pretty_pv(pos, depth, value, current_search_time(), Rml[0].pv) << endl;
+        {
+            char prettyPv[MAX_PRETTY_PV_STRING];
+            LogFile << pretty_pv(pos, depth, value, current_search_time(), Rml[0].pv, prettyPv) << endl;
+        }
 
-        // Init easyMove after first iteration or drop if differs from the best move
-        if (depth == 1 && (Rml.size() == 1 || Rml[0].pv_score > Rml[1].pv_score + EasyMoveMargin))
+        // Init easyMove after first iteration or drop if differs from the best move.
+        // With a split root the other moves are not ours to compare with.
+        if (depth == 1 && !rootSplit && (Rml.size() == 1 || Rml[0].pv_score > Rml[1].pv_score + EasyMoveMargin))
             easyMove = bestMove;
         else if (bestMove != easyMove)
             easyMove = MOVE_NONE;
@@ -704,6 +805,8 @@ namespace {
     posKey = excludedMove ? pos.get_exclusion_key() ^ excludedMove : pos.get_key();
 
     tte = TT.probe(posKey);
+    Threads[threadID].ttProbes++;
+    Threads[threadID].ttHits += (tte != NULL);
 	if (tte)
 	{
 		rtte = *tte;
@@ -913,8 +1016,8 @@ namespace {
 			{
 				Value rBeta = Max(beta + 200, Min(ss->eval + 100, VALUE_KNOWN_WIN));
 				Depth d = depth - 4 * ONE_PLY; // depth - (depth/2 + depth/6 + depth/12 + ONE_PLY/2);				
-				MovePicker mp(pos, ttMove, DEPTH_QS_NO_CHECKS, H);
 				CheckInfo ci(pos);
+				MovePicker mp(pos, ttMove, DEPTH_QS_NO_CHECKS, H, ci);
 
 				while ((move = mp.get_next_move()) != MOVE_NONE)					
 				{					
@@ -1378,17 +1481,30 @@ split_point_start: // At split points actual search starts from here
 
       } // Root
 
-      // Step 18. Check for split
+      // Step 18. Check for split. One ply short of the minimum split depth we
+      // only count the splits we miss while a thread is idle, as told by the
+      // shared count of idle threads, without looking at each of them.
       if (   !Root
           && !SpNode
-          && depth >= Threads.min_split_depth()
+          && depth >= Threads.min_split_depth() - ONE_PLY
           && bestValue < beta
 		  && !excludedMove
-          && Threads.available_slave_exists(threadID)
+          && Threads.size() > 1
           && !StopRequest
           && !Threads[threadID].cutoff_occurred())
-          Threads.split<FakeSplit>(pos, ss, &alpha, beta, &bestValue, &bestMove, depth,
-                                   threatMove, moveCount, &mp, PvNode);
+      {
+          Thread& thread = Threads[threadID];
+
+          if (depth < Threads.min_split_depth())
+              thread.refusedSplits[Thread::SHALLOW_DEPTH] += (Threads.idle_threads() > 0);
+
+          else if (!Threads.available_slave_exists(threadID))
+              thread.refusedSplits[Thread::NO_SLAVE]++;
+
+          else
+              Threads.split<FakeSplit>(pos, ss, &alpha, beta, &bestValue, &bestMove, depth,
+                                       threatMove, moveCount, &mp, PvNode);
+      }
     }	
 
     // Step 19. Check for mate and stalemate
@@ -1412,6 +1528,10 @@ split_point_start: // At split points actual search starts from here
 
 		TT.store(posKey, value_to_tt(bestValue, ss->ply), vt, ss->brokenThreat ? DEPTH_NONE : depth, bestMove, ss->eval, ss->evalMargin);
 
+		// Let the other cluster processes know about deep results
+		if (ClusterEnabled && depth >= ClusterShareDepth && !ss->brokenThreat)
+			cluster_share(posKey, value_to_tt(bestValue, ss->ply), vt, depth, bestMove, ss->eval, ss->evalMargin);
+
 		if (bestValue >= VALUE_MATE_IN_PLY_MAX)		
 			ss->mateKiller = bestMove;
 
@@ -1479,6 +1599,8 @@ split_point_start: // At split points actual search starts from here
     // Transposition table lookup. At PV nodes, we don't use the TT for
     // pruning, but only for move ordering.
     tte = TT.probe(pos.get_key());
+    Threads[pos.thread()].ttProbes++;
+    Threads[pos.thread()].ttHits += (tte != NULL);
 	if (tte)
 	{
 		rtte = *tte;
@@ -1522,7 +1644,7 @@ split_point_start: // At split points actual search starts from here
     else
     {
 		// Check for stalemate
-		if (PvNode && is_stalemate(pos))
+		if (PvNode && !pos.has_legal_move())
 			return VALUE_DRAW;
 
         if (tte)
@@ -1559,8 +1681,8 @@ split_point_start: // At split points actual search starts from here
     // to search the moves. Because the depth is <= 0 here, only captures,
     // queen promotions and checks (only if depth >= DEPTH_QS_CHECKS) will
     // be generated.
-    MovePicker mp(pos, ttMove, depth, H);
     CheckInfo ci(pos);
+    MovePicker mp(pos, ttMove, depth, H, ci);
 
     // Loop through the moves until no moves remain or a beta cutoff occurs
     while (   alpha < beta
@@ -1892,22 +2014,6 @@ split_point_start: // At split points actual search starts from here
   }
 
 
-  bool is_stalemate(const Position& pos) {
-  
-	  MoveStack mlist[MAX_MOVES];
-	  MoveStack *last, *cur = mlist;	 
-
-	  last = generate<MV_NON_EVASION>(pos, mlist);		
-	  while (cur != last)
-		  if (!pos.pl_move_is_legal(cur->move))
-			  cur->move = (--last)->move;
-		  else
-			  break;
-
-	  return cur == last;
-  }  
-
-
   // ok_to_use_TT() returns true if a transposition table score
   // can be used at a given point in search.
 
@@ -1997,32 +2103,28 @@ split_point_start: // At split points actual search starts from here
   // mate <y>   Mate in y moves, not plies. If the engine is getting mated
   //            use negative values for y.
 
-  std::string value_to_uci(Value v) {
-
-    std::stringstream s;
+  char* value_to_uci(Value v, char* buf) {
 
     if (abs(v) < VALUE_MATE - PLY_MAX)
-        s << "cp " << int(v) * 100 / int(PawnValueMidgame); // Scale to centipawns
+        sprintf(buf, "cp %d", int(v) * 100 / int(PawnValueMidgame)); // Scale to centipawns
     else
-        s << "mate " << (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2;
+        sprintf(buf, "mate %d", (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2);
 
-    return s.str();
+    return buf;
   }
 
 
   // speed_to_uci() returns a string with time stats of current search suitable
   // to be sent to UCI gui.
 
-  std::string speed_to_uci(int64_t nodes) {
+  char* speed_to_uci(int64_t nodes, char* buf) {
 
-    std::stringstream s;
     int t = current_search_time();
 
-    s << " nodes " << nodes
-      << " nps "   << (t > 0 ? int(nodes * 1000 / t) : 0)
-      << " time "  << t;
+    // Nodes could not fit an int, ISO C++ 1998 has no long long format
+    sprintf(buf, " nodes %.0f nps %d time %d", double(nodes), t > 0 ? int(nodes * 1000 / t) : 0, t);
 
-    return s.str();
+    return buf;
   }
 
 
@@ -2125,18 +2227,23 @@ split_point_start: // At split points actual search starts from here
   }
 
 
-  // When playing with strength handicap choose best move among the MultiPV set
-  // using a statistical rule dependent on SkillLevel. Idea by Heinz van Saanen.
+  // When playing with strength handicap choose best move among the candidate
+  // root moves using a statistical rule dependent on SkillLevel. Idea by Heinz
+  // van Saanen.
   void do_skill_level(Move* best, Move* ponder) {
 
-    assert(MultiPV > 1);
-
     static RKISS rk;
 
-    // Rml list is already sorted by pv_score in descending order
+    // Rml list is already sorted by pv_score in descending order, moves not
+    // scored by the MultiPV search, like the ones beyond MultiPV, are skipped.
     int s;
     int max_s = -VALUE_INFINITE;
-    int size = Min(MultiPV, (int)Rml.size());
+    int size = 1;
+
+    while (   size < Min(SkillCandidates, (int)Rml.size())
+           && Rml[size].pv_score != -VALUE_INFINITE)
+        size++;
+
     int max = Rml[0].pv_score;
     int var = Min(max - Rml[size - 1].pv_score, PawnValueMidgame);
     int wk = 120 - 2 * SkillLevel;
@@ -2191,6 +2298,27 @@ split_point_start: // At split points actual search starts from here
     return *this;
   }
 
+  // RootMoveList::sort() sorts the moves by descending pv_score keeping the
+  // order of equal ones. Unlike std::stable_sort() it does not allocate a
+  // temporary buffer; the list is short and mostly sorted already.
+
+  void RootMoveList::sort() {
+
+    for (size_t i = 1; i < size(); i++)
+    {
+        if (!((*this)[i] < (*this)[i - 1]))
+            continue;
+
+        RootMove rm = (*this)[i];
+        size_t j = i;
+
+        for ( ; j > 0 && rm < (*this)[j - 1]; j--)
+            (*this)[j] = (*this)[j - 1];
+
+        (*this)[j] = rm;
+    }
+  }
+
   void RootMoveList::init(Position& pos, Move searchMoves[]) {
 
     MoveStack mlist[MAX_MOVES];
@@ -2256,24 +2384,27 @@ split_point_start: // At split points actual search starts from here
     do pos.undo_move(pv[--ply]); while (ply);
   }
 
-  // pv_info_to_uci() returns a string with information on the current PV line
-  // formatted according to UCI specification.
+  // pv_info_to_uci() writes in buf, at least MaxInfoString long, the info on
+  // the current PV line formatted according to UCI specification.
 
-  std::string RootMove::pv_info_to_uci(Position& pos, int depth, Value alpha,
-                                       Value beta, int pvIdx) {
-    std::stringstream s;
+  char* RootMove::pv_info_to_uci(Position& pos, int depth, Value alpha,
+                                 Value beta, int pvIdx, char* buf) {
+    char* p = buf;
 
-    s << "info depth " << depth     
-      << " multipv " << pvIdx + 1
-      << " score " << value_to_uci(pv_score)
-      << (pv_score >= beta ? " lowerbound" : pv_score <= alpha ? " upperbound" : "")
-      << speed_to_uci(pos.nodes_searched())	  
-      << " pv ";
+    p += sprintf(p, "info depth %d multipv %d score ", depth, pvIdx + 1);
+    p += strlen(value_to_uci(pv_score, p));
+    p += sprintf(p, "%s", pv_score >= beta ? " lowerbound" : pv_score <= alpha ? " upperbound" : "");
+    p += strlen(speed_to_uci(pos.nodes_searched(), p));
+    p += sprintf(p, " pv ");
 
 	for (Move* m = pv; *m != MOVE_NONE; m++)
-		s << move_to_uci(*m, pos.is_chess960()) << " ";
+	{
+		p += strlen(move_to_uci(*m, pos.is_chess960(), p));
+		*p++ = ' ';
+	}
+    *p = 0;
 
-    return s.str();
+    return buf;
   }
 
 } // namespace
@@ -2338,7 +2469,16 @@ void ThreadsManager::idle_loop(int threadID, SplitPoint* sp) {
       {
           assert(!allThreadsShouldExit);
 
+          // Account the time spent waiting for work, see adapt_split_parameters().
+          // Cleared so that a nested split, entering here again, adds nothing.
+          if (threads[threadID].idleSince)
+          {
+              threads[threadID].idleTime += get_monotonic_time() - threads[threadID].idleSince;
+              threads[threadID].idleSince = 0;
+          }
+
           threads[threadID].state = Thread::SEARCHING;
+          threads[threadID].socket = use_local_attack_tables();
 
           // Copy split point position and search stack and call search()
           // with SplitPoint template parameter set to true.
@@ -2354,9 +2494,16 @@ void ThreadsManager::idle_loop(int threadID, SplitPoint* sp) {
           else
               search<NonPV, true, false>(pos, ss, tsp->alpha, tsp->beta, tsp->depth);		 
 
+          threads[threadID].socketNodes[threads[threadID].socket] += pos.nodes_searched();
+
           assert(threads[threadID].state == Thread::SEARCHING);
 
+          lock_grab(&mpLock);
           threads[threadID].state = Thread::AVAILABLE;
+          idleThreads++;
+          lock_release(&mpLock);
+
+          threads[threadID].idleSince = get_monotonic_time();
 
           // Wake up master thread so to allow it to return from the idle loop in
           // case we are the last slave of the split point.
@@ -2382,7 +2529,13 @@ void ThreadsManager::idle_loop(int threadID, SplitPoint* sp) {
           // because here is all finished is not possible master is booked.
           assert(threads[threadID].state == Thread::AVAILABLE);
 
+          threads[threadID].idleTime += get_monotonic_time() - threads[threadID].idleSince;
+          threads[threadID].idleSince = 0;
+
+          lock_grab(&mpLock);
           threads[threadID].state = Thread::SEARCHING;
+          idleThreads--;
+          lock_release(&mpLock);
           return;
       }
   }
@@ -67,6 +67,15 @@ struct SearchLimits {
   bool infinite, ponder;
 };
 
+/// When set, SearchIterationHook is called by the main thread at the end of
+/// each iteration with the depth, the best move and its score, the number
+/// of nodes searched and the elapsed time in milliseconds. It is used by
+/// tools that need to follow the search, like the EPD test runner.
+
+typedef void (*IterationHook)(int depth, Move bestMove, Value value, int64_t nodes, int time);
+
+extern IterationHook SearchIterationHook;
+
 extern void init_search();
 extern int64_t perft(Position& pos, Depth depth);
 extern bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]);
@@ -18,7 +18,10 @@
 */
 
 #include <iostream>
+#include <new>
+#include <sstream>
 
+#include "misc.h"
 #include "thread.h"
 #include "ucioption.h"
 
@@ -51,6 +54,43 @@ namespace { extern "C" {
 
 } }
 
+namespace {
+
+  // Limits of the split parameters adaptation, the same of the UCI options
+  const Depth MinSplitDepthLimit[] = { Depth(4 * ONE_PLY), Depth(7 * ONE_PLY) };
+  const int ThreadsPerSplitPointLimit[] = { 4, 8 };
+
+  // Thresholds of the adaptation, as fractions of the total thread time of
+  // the search for idle and setup time, of the split points for cutoffs.
+  const double MaxIdleRatio   = 0.10;
+  const double MaxSetupRatio  = 0.02;
+  const double LowCutoffRatio = 0.15;
+  const double MaxCutoffRatio = 0.25;
+
+  // resize_split_points() replaces the split point pool of a thread, that must
+  // have no active split points, with a new one of the given size.
+  void resize_split_points(Thread& thread, int size) {
+
+    assert(!thread.activeSplitPoints);
+
+    for (int j = 0; j < thread.splitPointsSize; j++)
+        lock_destroy(&(thread.splitPoints[j].lock));
+
+    delete [] thread.splitPoints;
+
+    thread.splitPoints = new (std::nothrow) SplitPoint[size];
+    if (!thread.splitPoints)
+    {
+        std::cerr << "Failed to allocate " << size << " split points." << std::endl;
+        ::exit(EXIT_FAILURE);
+    }
+    thread.splitPointsSize = size;
+
+    for (int j = 0; j < size; j++)
+        lock_init(&(thread.splitPoints[j].lock));
+  }
+}
+
 
 // wake_up() wakes up the thread, normally at the beginning of the search or,
 // if "sleeping threads" is used, when there is some work to do.
@@ -108,10 +148,109 @@ bool Thread::is_available_to(int master) const {
 
 void ThreadsManager::read_uci_options() {
 
-  maxThreadsPerSplitPoint = Options["Maximum Number of Threads per Split Point"].value<int>();
-  minimumSplitDepth       = Options["Minimum Split Depth"].value<int>() * ONE_PLY;
+  int splitDepth           = Options["Minimum Split Depth"].value<int>();
+  int threadsPerSplitPoint = Options["Maximum Number of Threads per Split Point"].value<int>();
+
   useSleepingThreads      = Options["Use Sleeping Threads"].value<bool>();
+  adaptiveSplit           = Options["Adaptive Split Parameters"].value<bool>();
   activeThreads           = Options["Threads"].value<int>();
+
+  // When the split parameters are adapted the options give only the starting
+  // values, set again if they or the number of threads change.
+  if (   !adaptiveSplit
+      || splitDepth != splitDepthOption
+      || threadsPerSplitPoint != threadsPerSplitOption
+      || activeThreads != threadsOption)
+  {
+      minimumSplitDepth       = splitDepth * ONE_PLY;
+      maxThreadsPerSplitPoint = threadsPerSplitPoint;
+      splitDepthOption        = splitDepth;
+      threadsPerSplitOption   = threadsPerSplitPoint;
+      threadsOption           = activeThreads;
+  }
+}
+
+
+// reset_split_statistics() is called at the beginning of the search to start
+// measuring the overhead of the split points, see adapt_split_parameters().
+// Helper threads are idle until they get some work.
+
+void ThreadsManager::reset_split_statistics() {
+
+  searchStart = get_monotonic_time();
+  splits = cutoffSplits = splitSetupTime = 0;
+  idleThreads = activeThreads - 1; // All the helpers wait for the first split
+
+  for (int i = 0; i < activeThreads; i++)
+  {
+      threads[i].idleSince = (i ? searchStart : 0);
+      threads[i].idleTime = 0;
+      memset(threads[i].refusedSplits, 0, sizeof(threads[i].refusedSplits));
+      memset(threads[i].socketNodes, 0, sizeof(threads[i].socketNodes));
+  }
+}
+
+
+// adapt_split_parameters() is called at the end of the search. It measures
+// the time spent setting up split points, the time threads have waited for
+// work and the split points ended by a beta cutoff, whose work was partly
+// wasted, and moves minimumSplitDepth and maxThreadsPerSplitPoint one step
+// accordingly for the next search, when "Adaptive Split Parameters" is set.
+// Idle threads call for more and larger split points, costly setups for
+// deeper ones, many cutoffs for fewer threads at each. Returns a report with
+// the statistics, with the refused splits, and the values chosen.
+
+std::string ThreadsManager::adapt_split_parameters() {
+
+  int64_t now = get_monotonic_time();
+  int64_t idleTime = 0, refused[Thread::REFUSED_SPLIT_NB] = { 0, 0, 0 };
+  int poolSize = 0;
+
+  for (int i = 0; i < activeThreads; i++)
+  {
+      idleTime += threads[i].idleTime + (threads[i].idleSince ? now - threads[i].idleSince : 0);
+      poolSize = Max(poolSize, threads[i].splitPointsSize);
+
+      for (int r = 0; r < Thread::REFUSED_SPLIT_NB; r++)
+          refused[r] += threads[i].refusedSplits[r];
+  }
+
+  double threadTime  = double(Max(now - searchStart, int64_t(1))) * activeThreads;
+  double idleRatio   = idleTime / threadTime;
+  double setupRatio  = splitSetupTime / threadTime;
+  double cutoffRatio = splits ? double(cutoffSplits) / splits : 0;
+
+  if (adaptiveSplit && splits)
+  {
+      if (idleRatio > MaxIdleRatio && setupRatio < MaxSetupRatio / 2)
+          minimumSplitDepth = Max(minimumSplitDepth - ONE_PLY, MinSplitDepthLimit[0]);
+
+      else if (   setupRatio > MaxSetupRatio
+               || (cutoffRatio > MaxCutoffRatio && idleRatio < MaxIdleRatio / 2))
+          minimumSplitDepth = Min(minimumSplitDepth + ONE_PLY, MinSplitDepthLimit[1]);
+
+      if (idleRatio > MaxIdleRatio && cutoffRatio < LowCutoffRatio)
+          maxThreadsPerSplitPoint = Min(maxThreadsPerSplitPoint + 1, ThreadsPerSplitPointLimit[1]);
+
+      else if (cutoffRatio > MaxCutoffRatio)
+          maxThreadsPerSplitPoint = Max(maxThreadsPerSplitPoint - 1, ThreadsPerSplitPointLimit[0]);
+  }
+
+  std::ostringstream s;
+
+  s << "split depth " << minimumSplitDepth / ONE_PLY
+    << " threads per split point " << maxThreadsPerSplitPoint
+    << (adaptiveSplit ? " (adaptive)" : "")
+    << " splits " << splits
+    << " cutoffs% " << int(100 * cutoffRatio)
+    << " setup% " << int(100 * setupRatio)
+    << " idle% " << int(100 * idleRatio)
+    << " refused no slave " << refused[Thread::NO_SLAVE]
+    << " stack full " << refused[Thread::STACK_FULL]
+    << " depth " << refused[Thread::SHALLOW_DEPTH]
+    << " split points " << poolSize;
+
+  return s.str();
 }
 
 
@@ -140,8 +279,7 @@ void ThreadsManager::init() {
       lock_init(&threads[i].sleepLock);
       cond_init(&threads[i].sleepCond);
 
-      for (int j = 0; j < MAX_ACTIVE_SPLIT_POINTS; j++)
-          lock_init(&(threads[i].splitPoints[j].lock));
+      resize_split_points(threads[i], MIN_SPLIT_POINTS);
   }
 
   // Create and startup all the threads but the main that is already running
@@ -189,8 +327,10 @@ void ThreadsManager::exit() {
       lock_destroy(&threads[i].sleepLock);
       cond_destroy(&threads[i].sleepCond);
 
-      for (int j = 0; j < MAX_ACTIVE_SPLIT_POINTS; j++)
+      for (int j = 0; j < threads[i].splitPointsSize; j++)
           lock_destroy(&(threads[i].splitPoints[j].lock));
+
+      delete [] threads[i].splitPoints;
   }
 
   lock_destroy(&mpLock);
@@ -201,18 +341,61 @@ void ThreadsManager::exit() {
 // according to the number of active threads. This avoids preallocating
 // memory for all possible threads if only few are used as, for instance,
 // on mobile devices where memory is scarce and allocating for MAX_THREADS
-// threads could even result in a crash.
+// threads could even result in a crash. Pawn tables are not needed when
+// the shared one is in use.
 
 void ThreadsManager::init_hash_tables() {
 
   for (int i = 0; i < activeThreads; i++)
   {
-      threads[i].pawnTable.init();
+      if (!SharedPawns.enabled())
+          threads[i].pawnTable.init();
+
       threads[i].materialTable.init();
   }
 }
 
 
+// grow_split_points() is called before the search, when no split point is in
+// use and the pools can be reallocated. The pool of a thread that refused
+// to split in the last search because it was full is doubled, so that deep
+// helpful master nesting is limited only by MAX_SPLIT_POINTS. Pools do not
+// grow during the search, that should not allocate.
+
+void ThreadsManager::grow_split_points() {
+
+  for (int i = 0; i < activeThreads; i++)
+      if (   threads[i].refusedSplits[Thread::STACK_FULL]
+          && threads[i].splitPointsSize < MAX_SPLIT_POINTS)
+          resize_split_points(threads[i], Min(2 * threads[i].splitPointsSize, MAX_SPLIT_POINTS));
+}
+
+
+// socket_speed() is called at the end of the search with replicated attack
+// tables. It reports the nodes per second searched by the threads running
+// on each NUMA node.
+
+std::string ThreadsManager::socket_speed() const {
+
+  double elapsed = double(Max(get_monotonic_time() - searchStart, int64_t(1))) / 1000000;
+  std::ostringstream s;
+
+  s << "nps per socket";
+
+  for (int n = 0; n < MaxNumaNodes; n++)
+  {
+      int64_t nodes = 0;
+
+      for (int i = 0; i < activeThreads; i++)
+          nodes += threads[i].socketNodes[n];
+
+      if (nodes)
+          s << " " << n << ": " << int64_t(nodes / elapsed);
+  }
+  return s.str();
+}
+
+
 // available_slave_exists() tries to find an idle thread which is available as
 // a slave for the thread with threadID "master".
 
@@ -252,14 +435,22 @@ void ThreadsManager::split(Position& pos, SearchStack* ss, Value* alpha, const V
 
   int i, master = pos.thread();
   Thread& masterThread = threads[master];
+  int64_t setupStart = get_monotonic_time();
 
   lock_grab(&mpLock);
 
   // If no other thread is available to help us, or if we have too many
   // active split points, don't split.
-  if (   !available_slave_exists(master)
-      || masterThread.activeSplitPoints >= MAX_ACTIVE_SPLIT_POINTS)
+  if (!available_slave_exists(master))
+  {
+      masterThread.refusedSplits[Thread::NO_SLAVE]++;
+      lock_release(&mpLock);
+      return;
+  }
+
+  if (masterThread.activeSplitPoints >= masterThread.splitPointsSize)
   {
+      masterThread.refusedSplits[Thread::STACK_FULL]++;
       lock_release(&mpLock);
       return;
   }
@@ -301,6 +492,7 @@ void ThreadsManager::split(Position& pos, SearchStack* ss, Value* alpha, const V
           threads[i].splitPoint = &splitPoint;
           splitPoint.is_slave[i] = true;
           workersCnt++;
+          idleThreads--;
       }
 
   assert(Fake || workersCnt > 1);
@@ -321,6 +513,8 @@ void ThreadsManager::split(Position& pos, SearchStack* ss, Value* alpha, const V
               threads[i].wake_up();
       }
 
+  int64_t setupTime = get_monotonic_time() - setupStart;
+
   // Everything is set up. The master thread enters the idle loop, from
   // which it will instantly launch a search, because its state is
   // THREAD_WORKISWAITING.  We send the split point as a second parameter to the
@@ -338,6 +532,11 @@ void ThreadsManager::split(Position& pos, SearchStack* ss, Value* alpha, const V
   masterThread.activeSplitPoints--;
   masterThread.splitPoint = splitPoint.parent;
   pos.set_nodes_searched(pos.nodes_searched() + splitPoint.nodes);
+  masterThread.socketNodes[masterThread.socket] -= splitPoint.nodes; // Counted by the slaves
+
+  splits++;
+  splitSetupTime += setupTime;
+  cutoffSplits += splitPoint.is_betaCutoff;
 
   lock_release(&mpLock);
 }
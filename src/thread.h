@@ -21,6 +21,7 @@
 #define THREAD_H_INCLUDED
 
 #include <cstring>
+#include <string>
 
 #include "lock.h"
 #include "material.h"
@@ -29,7 +30,8 @@
 #include "position.h"
 
 const int MAX_THREADS = 32;
-const int MAX_ACTIVE_SPLIT_POINTS = 8;
+const int MIN_SPLIT_POINTS = 8;       // Initial size of the split point pools
+const int MAX_SPLIT_POINTS = PLY_MAX; // At most one split point per ply
 
 struct SplitPoint {
 
@@ -76,6 +78,14 @@ struct Thread {
     TERMINATED     // We are quitting and thread is terminated
   };
 
+  enum RefusedSplit
+  {
+    NO_SLAVE,      // No idle thread could help us
+    STACK_FULL,    // All the split points of the pool are in use
+    SHALLOW_DEPTH, // A slave was idle but depth was one ply short of the minimum
+    REFUSED_SPLIT_NB
+  };
+
   void wake_up();
   bool cutoff_occurred() const;
   bool is_available_to(int master) const;
@@ -83,12 +93,18 @@ struct Thread {
   MaterialInfoTable materialTable;
   PawnInfoTable pawnTable;
   int maxPly;
+  int64_t ttProbes, ttHits; // Statistics of the last search, see benchmark()
+  int64_t idleSince, idleTime; // Waiting for work, see adapt_split_parameters()
+  int64_t refusedSplits[REFUSED_SPLIT_NB];
+  int socket; // NUMA node at the start of the last search, see use_local_attack_tables()
+  int64_t socketNodes[MaxNumaNodes];
   Lock sleepLock;
   WaitCondition sleepCond;
   volatile ThreadState state;
   SplitPoint* volatile splitPoint;
   volatile int activeSplitPoints;
-  SplitPoint splitPoints[MAX_ACTIVE_SPLIT_POINTS];
+  int splitPointsSize;
+  SplitPoint* splitPoints; // Pool of splitPointsSize objects, see grow_split_points()
 };
 
 
@@ -106,12 +122,17 @@ public:
   void init();
   void exit();
   void init_hash_tables();
+  void grow_split_points();
 
   int min_split_depth() const { return minimumSplitDepth; }
+  int idle_threads() const { return idleThreads; }
   int size() const { return activeThreads; }
   void set_size(int cnt) { activeThreads = cnt; }
 
   void read_uci_options();
+  void reset_split_statistics();
+  std::string adapt_split_parameters();
+  std::string socket_speed() const;
   bool available_slave_exists(int master) const;
   void idle_loop(int threadID, SplitPoint* sp);
 
@@ -123,8 +144,12 @@ private:
   Depth minimumSplitDepth;
   int maxThreadsPerSplitPoint;
   bool useSleepingThreads;
+  bool adaptiveSplit;
   int activeThreads;
+  int splitDepthOption, threadsPerSplitOption, threadsOption;
+  int64_t searchStart, splits, cutoffSplits, splitSetupTime;
   volatile bool allThreadsShouldExit;
+  volatile int idleThreads; // Helpers waiting for work, changed under mpLock
   Thread threads[MAX_THREADS];
 };
 
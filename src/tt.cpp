@@ -25,6 +25,19 @@
 
 TranspositionTable TT; // Our global transposition table
 
+namespace {
+
+  // Depth lost by an entry for each search it has not been used, up to
+  // MaxAgePenalty searches.
+  const int AgePenalty = 4 * ONE_PLY;
+  const int MaxAgePenalty = 8;
+
+  inline int entry_worth(const TTEntry* tte, int generation) {
+
+    return tte->depth() - AgePenalty * Min(tte->age(generation), MaxAgePenalty);
+  }
+}
+
 TranspositionTable::TranspositionTable() {
 
   size = generation = 0;
@@ -80,14 +93,15 @@ void TranspositionTable::clear() {
 /// TranspositionTable::store() writes a new entry containing position key and
 /// valuable information of current position. The lowest order bits of position
 /// key are used to decide on which cluster the position will be placed.
-/// When a new entry is written and there are no empty entries available in cluster,
-/// it replaces the least valuable of entries. A TTEntry t1 is considered to be
-/// more valuable than a TTEntry t2 if t1 is from the current search and t2 is from
-/// a previous search, or if the depth of t1 is bigger than the depth of t2.
+/// When a new entry is written and there are no empty entries available in
+/// cluster, the least valuable entry of the depth-preferred tier is replaced if
+/// it is from a previous search or not deeper than the new one. A replaced entry
+/// from the current search is moved to the always-replace slot, otherwise it is
+/// the new entry that goes there. An entry loses value with its age, so that old
+/// deep entries do not stay in the table forever.
 
 void TranspositionTable::store(const Key posKey, Value v, ValueType t, Depth d, Move m, Value statV, Value kingD) {
 
-  int c1, c2, c3;
   TTEntry *tte, *replace;
   uint32_t posKey32 = posKey >> 32; // Use the high 32 bits as key inside the cluster
 
@@ -104,15 +118,25 @@ void TranspositionTable::store(const Key posKey, Value v, ValueType t, Depth d,
           tte->save(posKey32, v, t, d, m, generation, statV, kingD);
           return;
       }
+  }
 
-      // Implement replace strategy
-      c1 = (replace->generation() == generation ?  2 : 0);
-      c2 = (tte->generation() == generation || tte->type() == VALUE_TYPE_EXACT ? -2 : 0);
-      c3 = (tte->depth() < replace->depth() ?  1 : 0);
+  tte = first_entry(posKey);
 
-      if (c1 + c2 + c3 > 0)
-          replace = tte;
+  for (int i = 1; i < DepthPreferredSize; i++)
+      if (entry_worth(tte + i, generation) < entry_worth(replace, generation))
+          replace = tte + i;
+
+  TTEntry* always = tte + DepthPreferredSize;
+
+  if (replace->age(generation) == 0 && d < replace->depth())
+  {
+      always->save(posKey32, v, t, d, m, generation, statV, kingD);
+      return;
   }
+
+  if (replace->age(generation) == 0)
+      *always = *replace;
+
   replace->save(posKey32, v, t, d, m, generation, statV, kingD);
 }
 
@@ -140,5 +164,5 @@ TTEntry* TranspositionTable::probe(const Key posKey) const {
 /// entries from the current search.
 
 void TranspositionTable::new_search() {
-  generation++;
+  generation = (generation + 1) & GenerationMask;
 }
@@ -40,9 +40,12 @@
 /// the 32 bits of the data field are so defined
 ///
 /// bit  0-15: move
-/// bit 16-20: not used
-/// bit 21-22: value type
-/// bit 23-31: generation
+/// bit 16-17: value type
+/// bit 18-31: generation
+
+/// Generations are counted modulo 2^14 and compared only through their
+/// difference, so that the age of an entry is correct across wraparound.
+const int GenerationMask = (1 << 14) - 1;
 
 class TTEntry {
 
@@ -51,34 +54,39 @@ public:
 
     key32        = (uint32_t)k;
     move16       = (uint16_t)m;
-    valueType    = (uint8_t)t;
-    generation8  = (uint8_t)g;
+    genType16    = (uint16_t)((g << 2) | t);
     value16      = (int16_t)v;
     depth16      = (int16_t)d;
     staticValue  = (int16_t)statV;
     staticMargin = (int16_t)statM;
   }
-  void set_generation(int g) { generation8 = (uint8_t)g; }
+  void set_generation(int g) { genType16 = (uint16_t)((g << 2) | (genType16 & 3)); }
 
   uint32_t key() const              { return key32; }
   Depth depth() const               { return (Depth)depth16; }
   Move move() const                 { return (Move)move16; }
   Value value() const               { return (Value)value16; }
-  ValueType type() const            { return (ValueType)valueType; }
-  int generation() const            { return (int)generation8; }
+  ValueType type() const            { return (ValueType)(genType16 & 3); }
+  int generation() const            { return (int)(genType16 >> 2); }
   Value static_value() const        { return (Value)staticValue; }
   Value static_value_margin() const { return (Value)staticMargin; }
 
+  // Number of searches since the entry was written or refreshed
+  int age(int g) const { return (g - generation()) & GenerationMask; }
+
 private:
   uint32_t key32;
   uint16_t move16;
-  uint8_t valueType, generation8;
+  uint16_t genType16;
   int16_t value16, depth16, staticValue, staticMargin;
 };
 
 
-/// This is the number of TTEntry slots for each cluster
+/// This is the number of TTEntry slots for each cluster. The first ones are
+/// depth-preferred, replaced only by deeper or fresher entries, the last one
+/// is always-replace and gets whatever does not make it in the first tier.
 const int ClusterSize = 4;
+const int DepthPreferredSize = ClusterSize - 1;
 
 
 /// TTCluster consists of ClusterSize number of TTEntries. Size of TTCluster
@@ -112,7 +120,7 @@ public:
 private:
   size_t size;
   TTCluster* entries;
-  uint8_t generation; // Size must be not bigger then TTEntry::generation8
+  int generation; // Modulo GenerationMask + 1, see TTEntry::age()
 };
 
 extern TranspositionTable TT;
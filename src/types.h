@@ -68,6 +68,10 @@ typedef unsigned __int64 uint64_t;
 ////                | Works only in 64-bit mode. For compiling requires hardware
 ////                | with popcnt support. Around 4% speed-up.
 ////
+//// -DUSE_AVX2     | Use AVX2 integer kernels in network evaluation instead of the
+////                | SSE2 ones. For compiling and running requires hardware with
+////                | AVX2 support.
+////
 //// -DOLD_LOCKS    | By default under Windows are used the fast Slim Reader/Writer (SRW)
 ////                | Locks and Condition Variables: these are not supported by Windows XP
 ////                | and older, to compile for those platforms you should enable OLD_LOCKS.
@@ -94,6 +98,13 @@ typedef unsigned __int64 uint64_t;
 #define CACHE_LINE_ALIGNMENT  __attribute__ ((aligned(64)))
 #endif
 
+// Thread local storage specification
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 // Define a __cpuid() function for gcc compilers, for Intel and MSVC
 // is already available as an intrinsic.
 #if defined(_MSC_VER)
@@ -266,17 +277,16 @@ enum ScaleFactor {
 };
 
 
-/// Score enum keeps a midgame and an endgame value in a single
-/// integer (enum), first LSB 16 bits are used to store endgame
-/// value, while upper bits are used for midgame value. Compiler
-/// is free to choose the enum type as long as can keep its data,
-/// so ensure Score to be an integer type.
-enum Score {
-    SCORE_ZERO = 0,
-    SCORE_ENSURE_INTEGER_SIZE_P = INT_MAX,
-    SCORE_ENSURE_INTEGER_SIZE_N = INT_MIN
+/// Score struct keeps a midgame and an endgame value in two separate 32 bit
+/// lanes. Each lane is exact, so a term can not carry into the other one and
+/// division, weighting and accumulation of large terms are always safe. It is
+/// kept a POD type because it is part of StateInfo and of the hash entries.
+struct Score {
+  int mg, eg;
 };
 
+const Score SCORE_ZERO = { 0, 0 };
+
 #define ENABLE_OPERATORS_ON(T) \
 inline T operator+ (const T d1, const T d2) { return T(int(d1) + int(d2)); } \
 inline T operator- (const T d1, const T d2) { return T(int(d1) - int(d2)); } \
@@ -306,38 +316,33 @@ ENABLE_OPERATORS_ON(Rank)
 inline Value operator+ (Value v, int i) { return Value(int(v) + i); }
 inline Value operator- (Value v, int i) { return Value(int(v) - i); }
 
-// Extracting the _signed_ lower and upper 16 bits it not so trivial
-// because according to the standard a simple cast to short is
-// implementation defined and so is a right shift of a signed integer.
-inline Value mg_value(Score s) { return Value(((int(s) + 32768) & ~0xffff) / 0x10000); }
+inline Value mg_value(Score s) { return Value(s.mg); }
+inline Value eg_value(Score s) { return Value(s.eg); }
 
-// Unfortunatly on Intel 64 bit we have a small speed regression, so use a faster code in
-// this case, although not 100% standard compliant it seems to work for Intel and MSVC.
-#if defined(IS_64BIT) && (!defined(__GNUC__) || defined(__INTEL_COMPILER))
-inline Value eg_value(Score s) { return Value(int16_t(s & 0xffff)); }
-#else
-inline Value eg_value(Score s) { return Value((int)(unsigned(s) & 0x7fffu) - (int)(unsigned(s) & 0x8000u)); }
-#endif
-
-inline Score make_score(int mg, int eg) { return Score((mg << 16) + eg); }
+inline Score make_score(int mg, int eg) { Score s = { mg, eg }; return s; }
 
-// Division must be handled separately for each term
-inline Score operator/(Score s, int i) { return make_score(mg_value(s) / i, eg_value(s) / i); }
-
-// Only declared but not defined. We don't want to multiply two scores due to
-// a very high risk of overflow. So user should explicitly convert to integer.
+// Multiplying two scores is meaningless, use apply_weight() to scale a score
+// lane by lane.
 inline Score operator*(Score s1, Score s2);
 
-// Remaining Score operators are standard
-inline Score operator+ (const Score d1, const Score d2) { return Score(int(d1) + int(d2)); }
-inline Score operator- (const Score d1, const Score d2) { return Score(int(d1) - int(d2)); }
-inline Score operator* (int i, const Score d) {  return Score(i * int(d)); }
-inline Score operator* (const Score d, int i) {  return Score(int(d) * i); }
-inline Score operator- (const Score d) { return Score(-int(d)); }
-inline void operator+= (Score& d1, const Score d2) { d1 = d1 + d2; }
-inline void operator-= (Score& d1, const Score d2) { d1 = d1 - d2; }
-inline void operator*= (Score& d, int i) { d = Score(int(d) * i); }
-inline void operator/= (Score& d, int i) { d = Score(int(d) / i); }
+inline Score operator+ (const Score d1, const Score d2) { return make_score(d1.mg + d2.mg, d1.eg + d2.eg); }
+inline Score operator- (const Score d1, const Score d2) { return make_score(d1.mg - d2.mg, d1.eg - d2.eg); }
+inline Score operator* (int i, const Score d) { return make_score(i * d.mg, i * d.eg); }
+inline Score operator* (const Score d, int i) { return make_score(d.mg * i, d.eg * i); }
+inline Score operator/ (const Score d, int i) { return make_score(d.mg / i, d.eg / i); }
+inline Score operator- (const Score d) { return make_score(-d.mg, -d.eg); }
+inline void operator+= (Score& d1, const Score d2) { d1.mg += d2.mg; d1.eg += d2.eg; }
+inline void operator-= (Score& d1, const Score d2) { d1.mg -= d2.mg; d1.eg -= d2.eg; }
+inline void operator*= (Score& d, int i) { d.mg *= i; d.eg *= i; }
+inline void operator/= (Score& d, int i) { d.mg /= i; d.eg /= i; }
+inline bool operator== (const Score d1, const Score d2) { return d1.mg == d2.mg && d1.eg == d2.eg; }
+inline bool operator!= (const Score d1, const Score d2) { return !(d1 == d2); }
+
+// apply_weight() scales each lane of a score by the corresponding lane of a
+// weight, where 0x100 stands for 100%.
+inline Score apply_weight(Score v, Score w) {
+  return make_score(v.mg * w.mg / 0x100, v.eg * w.eg / 0x100);
+}
 
 const Value PieceValueMidgame[8] = {
   VALUE_ZERO,
@@ -23,6 +23,7 @@
 #include <string>
 
 #include "evaluate.h"
+#include "mate.h"
 #include "misc.h"
 #include "move.h"
 #include "position.h"
@@ -44,7 +45,9 @@ namespace {
   void set_option(UCIParser& up);
   void set_position(Position& pos, UCIParser& up);
   bool go(Position& pos, UCIParser& up);
+  bool go_mate(Position& pos, int n, SearchLimits& limits, Move searchMoves[], bool* quit);
   void perft(Position& pos, UCIParser& up);
+  void send_uci_id();
 }
 
 
@@ -107,10 +110,7 @@ void execute_uci_command() {
            << "\npawn key: "     << pos.get_pawn_key() << endl;
 	  
 	  else if (token == "uci")
-		  cout << "id name "     << engine_name()
-           << "\nid author " << engine_authors()
-           << "\n"           << Options.print_all()
-           << "\nuciok"      << endl;
+		  send_uci_id();
 	  
 	  else
 		  cout << "Unknown command: " << cmd << endl;
@@ -118,8 +118,40 @@ void execute_uci_command() {
 }
 
 
+/// startup_handshake() replays what a GUI does right after starting the
+/// engine: a "uci" command, then a search of the start position to depth 1.
+/// The monotonic times of "uciok" and of "bestmove" are returned for the
+/// startup profile.
+
+void startup_handshake(int64_t* uciokTime, int64_t* bestmoveTime) {
+
+  Position pos(StartPositionFEN, false, 0);
+  SearchLimits limits;
+  Move moves[] = { MOVE_NONE };
+
+  send_uci_id();
+  *uciokTime = get_monotonic_time();
+
+  limits.maxDepth = 1;
+  think(pos, limits, moves);
+  *bestmoveTime = get_monotonic_time();
+}
+
+
 namespace {
 
+  // send_uci_id() answers the "uci" command with the engine name and the
+  // available options.
+
+  void send_uci_id() {
+
+    cout << "id name "     << engine_name()
+         << "\nid author " << engine_authors()
+         << "\n"           << Options.print_all()
+         << "\nuciok"      << endl;
+  }
+
+
   // set_position() is called when engine receives the "position" UCI
   // command. The function sets up the position described in the given
   // fen string ("fen") or the starting position ("startpos") and then
@@ -198,6 +230,7 @@ namespace {
     SearchLimits limits;
     Move searchMoves[MAX_MOVES], *cur = searchMoves;
     int time[] = { 0, 0 }, inc[] = { 0, 0 };
+    int mate = 0;
 
     while (up >> token)
     {
@@ -221,6 +254,8 @@ namespace {
             up >> limits.maxNodes;
         else if (token == "movetime")
             up >> limits.maxTime;
+        else if (token == "mate")
+            up >> mate;
         else if (token == "searchmoves")
             while (up >> token)
                 *cur++ = move_from_uci(pos, token);
@@ -232,10 +267,96 @@ namespace {
 
     assert(pos.is_ok());
 
+    // A mate search is answered by the mate solver, if it finds no mate
+    // giving check at every move we fall back on the normal search, limited
+    // to the mate length when no other limit is given.
+    if (mate > 0)
+    {
+        bool quit = false;
+
+        if (go_mate(pos, mate, limits, searchMoves, &quit))
+            return !quit;
+
+        if (limits.useTimeManagement() && !limits.time)
+            limits.maxDepth = 2 * mate;
+    }
+
     return think(pos, limits, searchMoves);
   }
 
 
+  // go_mate() runs the mate solver for "go mate". When a mate is found it
+  // prints it with the best move, as the search would do, and returns true.
+  // Otherwise the limits are adjusted to the commands read and to the
+  // time or the nodes used while solving and false is returned. When pondering or in infinite mode the best move
+  // is printed only after "stop" or "ponderhit", quit is set on "quit".
+
+  bool go_mate(Position& pos, int n, SearchLimits& limits, Move searchMoves[], bool* quit) {
+
+    Move pv[2 * MaxMateMoves];
+    MateCommand command;
+    int64_t nodes;
+    int time = get_system_time();
+    int moves = mate_search(pos, n, limits, searchMoves, pv, &nodes, &command);
+
+    time = get_system_time() - time;
+
+    if (command == MATE_QUIT)
+    {
+        *quit = true;
+        return true;
+    }
+
+    if (!moves)
+    {
+        if (command >= MATE_LIMIT)
+        {
+            // Stopped or out of time or nodes before finding a mate, a depth
+            // 1 search picks the move
+            limits = SearchLimits();
+            limits.maxDepth = 1;
+            return false;
+        }
+
+        if (command == MATE_PONDERHIT)
+            limits.ponder = false;
+
+        cout << "info string no mate in " << n << " by checks" << endl;
+        return false;
+    }
+
+    cout << "info depth " << 2 * moves - 1
+         << " score mate " << moves
+         << " nodes " << nodes
+         << " nps " << nodes * 1000 / Max(time, 1)
+         << " time " << time << " pv";
+
+    for (Move* m = pv; *m != MOVE_NONE; m++)
+        cout << " " << move_to_uci(*m, pos.is_chess960());
+
+    cout << endl;
+
+    // The best move can't be given before the GUI allows it, as in think()
+    if (limits.infinite || (limits.ponder && command != MATE_PONDERHIT))
+    {
+        string token;
+
+        while (   getline(cin, token)
+               && token != "ponderhit" && token != "stop" && token != "quit") {}
+
+        *quit = (token != "ponderhit" && token != "stop");
+    }
+
+    cout << "bestmove " << move_to_uci(pv[0], pos.is_chess960());
+
+    if (pv[1] != MOVE_NONE)
+        cout << " ponder " << move_to_uci(pv[1], pos.is_chess960());
+
+    cout << endl;
+    return true;
+  }
+
+
   // perft() is called when engine receives the "perft" command.
   // The function calls perft() passing the required search depth
   // then prints counted leaf nodes and elapsed time.
@@ -79,11 +79,19 @@ OptionsMap::OptionsMap() {
   o["Space"] = UCIOption(100, 0, 200);
   o["Aggressiveness"] = UCIOption(100, 0, 200);
   o["Cowardice"] = UCIOption(100, 0, 200);
+  o["Use NN Eval"] = UCIOption(false);
+  o["NN Weights File"] = UCIOption("sting.nn");
+  o["Use Kogge-Stone Attacks"] = UCIOption(false);
   o["Minimum Split Depth"] = UCIOption(4, 4, 7);
   o["Maximum Number of Threads per Split Point"] = UCIOption(5, 4, 8);
+  o["Adaptive Split Parameters"] = UCIOption(false);
   o["Threads"] = UCIOption(1, 1, MAX_THREADS);
   o["Use Sleeping Threads"] = UCIOption(false);
+  o["Cluster Port"] = UCIOption(0, 0, 65535);
+  o["Cluster Interface"] = UCIOption("127.0.0.1");
   o["Hash"] = UCIOption(32, 4, 8192);
+  o["Shared Pawn Hash"] = UCIOption(0, 0, 1024);
+  o["NUMA Replicated Tables"] = UCIOption(false);
   o["Clear Hash"] = UCIOption(false, "button");
   o["Ponder"] = UCIOption(true);
   o["OwnBook"] = UCIOption(true);